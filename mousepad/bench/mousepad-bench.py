@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""
+Scaled benchmark for mousepad: generates patches with many mousepads, runs
+them in Pd without GUI in batch mode and records timings.
+
+For each pad count and configuration a pad patch and a driver patch are
+generated. The driver opens the pad patch and times these phases with
+[realtime], printing them to Pd's console:
+
+  load    open the pad patch (mousepad_new for all pads)
+  save    save the pad patch to file (mousepad_save for all pads), under its
+          own name so that the canvas keeps its 'pd-bench-pads.pd' binding
+  pos     bulk 'delta' messages to all pads through their shared receive name
+  color   bulk 'color' messages with a new color each time
+  hover   injected 'pointer' events with button up
+  drag    injected 'pointer' events with button down
+  close   close the pad patch (mousepad_free for all pads)
+
+Configurations:
+
+  recv         receive name only
+  send         also a send name, but nothing listening
+  send-listen  send name with an [r] listening
+  colors       receive name only, every pad created with a distinct color
+
+Results are appended to a JSON lines file, one record per phase, tagged with
+the git version of the tree so that runs of different versions can be
+compared. Example:
+
+  ./mousepad-bench.py --pd /usr/bin/pd --pads 100 1000 10000
+
+Requires Pd 0.51 or later for -batch, and a built mousepad in the directory
+above this script (or give --path).
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CONFIGS = ["recv", "send", "send-listen", "colors"]
+PHASES = ["load", "save", "pos", "color", "hover", "drag", "close"]
+PADPATCH = "bench-pads.pd"
+ERROR = re.compile(r"error|no such object|couldn't create|bad arguments",
+                   re.IGNORECASE)
+
+
+class Patch:
+    """Minimal Pd patch writer: objects are numbered in order of creation."""
+
+    def __init__(self, width=800, height=600):
+        self.lines = ["#N canvas 0 0 %d %d 10;" % (width, height)]
+        self.count = 0
+        self.connections = []
+
+    def add(self, kind, text, x=0, y=0):
+        self.lines.append("#X %s %d %d %s;" % (kind, x, y, text))
+        self.count += 1
+        return self.count - 1
+
+    def obj(self, text, x=0, y=0):
+        return self.add("obj", text, x, y)
+
+    def msg(self, text, x=0, y=0):
+        # semicolons and dollars are escaped in the file format
+        return self.add("msg", text.replace(";", "\\;").replace("$", "\\$"),
+                        x, y)
+
+    def connect(self, src, outlet, dst, inlet):
+        self.connections.append("#X connect %d %d %d %d;" % (src, outlet, dst, inlet))
+
+    def write(self, path):
+        with open(path, "w") as f:
+            f.write("\n".join(self.lines + self.connections) + "\n")
+
+
+def pad_patch(npads, config):
+    columns = max(1, int(npads ** 0.5))
+    patch = Patch()
+    send = "bench-s" if config in ("send", "send-listen") else "empty"
+
+    for i in range(npads):
+        x, y = 10 + 25 * (i % columns), 10 + 25 * (i // columns)
+        color = "#%06X" % ((i * 2654435761) & 0xFFFFFF) if config == "colors" \
+            else "#DDDDDD"
+        patch.obj("mousepad 20 20 %s bench-r %s" % (send, color), x, y)
+
+    if config == "send-listen":
+        patch.obj("r bench-s", 10, 10 + 25 * (npads // columns + 1))
+
+    return patch
+
+
+def driver_patch(directory, events):
+    """One step per phase: [r step-k] -> [t b b b b], outlets fire right to
+    left: reset timer, run action, read timer and print, start next step."""
+
+    patch = Patch()
+    out = patch.obj("print BENCH")
+
+    def loop(count, message):
+        # bang -> count iterations of message with iteration number as $1
+        start = patch.msg(str(count))
+        until = patch.obj("until")
+        counter = patch.obj("f")
+        plus = patch.obj("+ 1")
+        action = patch.msg(message)
+        patch.connect(start, 0, until, 0)
+        patch.connect(until, 0, counter, 0)
+        patch.connect(counter, 0, plus, 0)
+        patch.connect(plus, 0, counter, 1)
+        patch.connect(counter, 0, action, 0)
+        return start
+
+    def sequence(*entries):
+        # bang -> entries in given order
+        trigger = patch.obj("t" + " b" * len(entries))
+        for i, entry in enumerate(entries):
+            patch.connect(trigger, len(entries) - 1 - i, entry, 0)
+        return trigger
+
+    actions = {
+        "load": patch.msg("; pd open %s %s" % (PADPATCH, directory)),
+        # saving under another name would rename the canvas, and the
+        # following menuclose would reach no receiver
+        "save": patch.msg("; pd-%s savetofile %s %s"
+                          % (PADPATCH, PADPATCH, directory)),
+        "pos": loop(events, "; bench-r delta 1 0"),
+        "color": loop(events, "; bench-r color $1"),
+        "hover": sequence(patch.msg("; bench-r button 0"),
+                          loop(events, "; bench-r pointer $1 $1")),
+        "drag": sequence(patch.msg("; bench-r button 1"),
+                         loop(events, "; bench-r pointer $1 $1"),
+                         patch.msg("; bench-r button 0")),
+        "close": patch.msg("; pd-%s menuclose 1" % PADPATCH),
+    }
+
+    start = patch.obj("loadbang")
+    patch.connect(start, 0, patch.obj("s step-0"), 0)
+
+    for k, phase in enumerate(PHASES):
+        receive = patch.obj("r step-%d" % k)
+        trigger = patch.obj("t b b b b")
+        timer = patch.obj("realtime")
+        report = patch.msg("%s $1" % phase)
+        following = patch.obj("s step-%d" % (k + 1))
+        patch.connect(receive, 0, trigger, 0)
+        patch.connect(trigger, 3, timer, 0)
+        patch.connect(trigger, 2, actions[phase], 0)
+        patch.connect(trigger, 1, timer, 1)
+        patch.connect(timer, 0, report, 0)
+        patch.connect(report, 0, out, 0)
+        patch.connect(trigger, 0, following, 0)
+
+    done = patch.obj("r step-%d" % len(PHASES))
+    patch.connect(done, 0, patch.msg("; pd quit"), 0)
+
+    return patch
+
+
+def version():
+    try:
+        return subprocess.check_output(
+            ["git", "describe", "--always", "--dirty"], cwd=HERE,
+            stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def run(args, npads, config):
+    with tempfile.TemporaryDirectory(prefix="mousepad-bench-") as directory:
+        pad_patch(npads, config).write(os.path.join(directory, PADPATCH))
+        driver_patch(directory, args.events).write(
+            os.path.join(directory, "bench-driver.pd"))
+
+        command = [args.pd, "-nogui", "-batch", "-noprefs", "-stderr",
+                   "-path", args.path, "-open",
+                   os.path.join(directory, "bench-driver.pd")]
+        try:
+            result = subprocess.run(command, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT,
+                                    timeout=args.timeout)
+        except subprocess.TimeoutExpired:
+            print("timeout: %d pads, %s" % (npads, config), file=sys.stderr)
+            return {}
+
+    timings = {}
+    errors = []
+    for line in result.stdout.decode(errors="replace").splitlines():
+        match = re.match(r"BENCH: (\w+) ([-0-9.e]+)", line)
+        if match:
+            timings[match.group(1)] = float(match.group(2))
+        elif ERROR.search(line):
+            errors.append(line)
+
+    # a phase whose messages reach no receiver still gets a time, so any
+    # error fails the whole run rather than recording meaningless numbers
+    if errors:
+        print("failed: %d pads, %s:\n  %s" % (npads, config, "\n  ".join(errors)),
+              file=sys.stderr)
+        return {}
+
+    missing = [phase for phase in PHASES if phase not in timings]
+    if missing:
+        print("missing phases %s: %d pads, %s" % (missing, npads, config),
+              file=sys.stderr)
+
+    return timings
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--pd", default="pd", help="Pd executable")
+    parser.add_argument("--path", default=os.path.dirname(HERE),
+                        help="directory with built mousepad")
+    parser.add_argument("--pads", type=int, nargs="+", default=[100, 1000, 10000])
+    parser.add_argument("--configs", nargs="+", default=CONFIGS, choices=CONFIGS)
+    parser.add_argument("--events", type=int, default=100,
+                        help="messages per bulk phase")
+    parser.add_argument("--timeout", type=float, default=600)
+    parser.add_argument("--output", default=os.path.join(HERE, "results.jsonl"),
+                        help="JSON lines file, results are appended")
+    args = parser.parse_args()
+
+    tag = version()
+    stamp = time.strftime("%Y-%m-%dT%H:%M:%S")
+
+    with open(args.output, "a") as output:
+        for npads in args.pads:
+            for config in args.configs:
+                timings = run(args, npads, config)
+                for phase in PHASES:
+                    if phase not in timings:
+                        continue
+                    record = {"version": tag, "time": stamp, "pads": npads,
+                              "config": config, "events": args.events,
+                              "phase": phase, "ms": timings[phase]}
+                    output.write(json.dumps(record) + "\n")
+                    print("%6d %-12s %-6s %10.2f ms"
+                          % (npads, config, phase, timings[phase]))
+
+
+if __name__ == "__main__":
+    main()
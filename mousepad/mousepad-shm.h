@@ -0,0 +1,85 @@
+/*******************************************************************************
+* Shared memory layout of mousepad pointer state, for readers in other
+* processes. A mousepad with an [export <name>( setting publishes its state
+* in POSIX shared memory object "/<name>" and updates it on every mouse event.
+* 
+* Access is guarded by a sequence lock: the writer makes 'seq' odd before
+* updating and even again afterwards. A reader copies the block and retries
+* if 'seq' was odd or changed meanwhile, see mousepad_shm_read() below. Readers
+* never block the writer and need no system calls after mapping the object.
+* 
+* Reader example (error checks omitted):
+* 
+*   int fd = shm_open("/mypad", O_RDONLY, 0);
+*   const t_mousepad_shm* shm = mmap(NULL, sizeof(t_mousepad_shm), PROT_READ,
+*                                     MAP_SHARED, fd, 0);
+*   t_mousepad_state state;
+*   mousepad_shm_read(shm, &state);
+* 
+* Values are nominal (zoom factor 1) like the messages from mousepad's outlet.
+* 
+*******************************************************************************/
+
+#ifndef MOUSEPAD_SHM_H
+#define MOUSEPAD_SHM_H
+
+#include <stdint.h>
+
+#define MOUSEPAD_SHM_MAGIC   0x4D505348     // "MPSH"
+#define MOUSEPAD_SHM_VERSION 1
+
+
+typedef struct
+{
+    int32_t   xval;         // mouse x relative to object
+    int32_t   yval;         // mouse y relative to object
+    int32_t   buttonstate;  // mouse button state 1 or 0
+    int32_t   deltax;       // x change by last event
+    int32_t   deltay;       // y change by last event
+    uint32_t  unused;
+    uint64_t  stamp;        // number of updates since export started
+    double    logicaltime;  // Pd logical time of last update
+} t_mousepad_state;
+
+
+typedef struct
+{
+    uint32_t  magic;        // MOUSEPAD_SHM_MAGIC when initialized
+    uint32_t  version;      // MOUSEPAD_SHM_VERSION
+    uint32_t  seq;          // sequence lock, odd while writer is busy
+    uint32_t  unused;
+    t_mousepad_state state;
+} t_mousepad_shm;
+
+
+// Copy consistent state from shared memory, spinning while the writer is busy.
+static inline void mousepad_shm_read(const t_mousepad_shm* shm,
+                                        t_mousepad_state* state)
+{
+    uint32_t seq1, seq2;
+    
+    do
+    {
+        seq1 = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        *state = shm->state;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+    }
+    while((seq1 & 1) || (seq1 != seq2));
+}
+
+
+// Writer side, used by mousepad.
+static inline void mousepad_shm_write(t_mousepad_shm* shm,
+                                        const t_mousepad_state* state)
+{
+    uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+    
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    shm->state = *state;
+    __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+
+#endif // MOUSEPAD_SHM_H
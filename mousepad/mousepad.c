@@ -9,10 +9,17 @@
 * - mouse x y coordinates respective to widget during drag and hover
 * - mouse x y deltas during drag
 * - no mouse button up event (yet)
+* - output filters: event types, required modifier keys, dead zone, change only
 * - no label
-* - no visible position indicator
-* - fill color (integer or webcolor regular and short)
+* - optional position indicator: crosshair and fading trail
+* - fill color (integer or webcolor regular and short, hsv, hsl, palette)
+* - color gradients over groups of objects, redrawn in one batch
 * - properties dialog implemented as abstraction
+* - state replication to another Pd process on the same machine, received
+*   there by companion class [mousepad-mirror]
+* - pointer state export to POSIX shared memory (see mousepad-shm.h)
+* - polled pointer state readers [mousepad-state] and [mousepad-state~]
+* - glides of position, size and color, stepped together for all objects
 * 
 * One reason for not using the iemgui framework is to avoid some outdated
 * arrangements, in particular the old color definitions and the raute2dollar
@@ -29,6 +36,10 @@
 * will probably introduce tons of issues, confusions and doubts. It is an
 * exploration of possibilities, nothing definitive.
 * 
+* Companion classes are registered in mousepad_setup(), so they can only be
+* created after a [mousepad] was loaded. Put [declare -lib mousepad] in a
+* patch which uses them without a [mousepad].
+* 
 * Pure Data is the work of Miller Puckette and others. License for this class 
 * not decided yet.
 * 
@@ -41,20 +52,27 @@
 #include "m_pd.h"
 #include "g_canvas.h"
 #include "m_imp.h"    // for t_class definition
+#include "mousepad-shm.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdarg.h>
 
 #ifdef MSW
 #include <io.h>
 #include <fcntl.h>
+#include <winsock2.h> // for replication socket
 #else
 #include <unistd.h>
 #include <sys/stat.h> // for file open
 #include <fcntl.h>    // for file open
+#include <sys/socket.h>  // for replication socket
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>    // for shared memory export
 #endif
 
 #define COLOR_SELECTED 0x0000FF     // outline color when selected (blue)
@@ -70,6 +88,50 @@
 #define INLET  2    // 0b010
 #define OUTLET 4    // 0b100
 
+// optional position indicator parts, drawn as lines inside the base rectangle
+#define CURSOR 8    // crosshair
+#define TRAIL  16   // trail bands have numbers TRAIL till TRAIL + TRAILBANDS - 1
+#define TRAILBANDS 4      // trail is split in bands with increasing fade
+#define TRAILMAX   64     // maximum number of trail points
+
+// replicated fields, bits in the 'mask' byte of a state record
+#define REPL_XY      1    // mouse x y relative to object
+#define REPL_BUTTON  2    // mouse button state
+#define REPL_POS     4    // object position on canvas
+#define REPL_SIZE    8    // object width and height
+#define REPL_COLOR   16   // fill color
+#define REPL_ALL     31
+#define REPL_FIELDS  5    // number of REPL_* bits
+#define REPL_VALUES  8    // number of integers in all fields
+#define REPL_REFRESH 1000 // interval of full state packets in milliseconds
+#define REPL_MAGIC   "MPR2"
+#define REPL_MAXRECORD 289  // header (2) + channel name (255) + fields (32)
+#define REPL_MAXPACKET 1400 // magic (4) + records, within a typical MTU
+
+// glide animations, index in glide array and bit in active glides flag
+#define GLIDE_POS    0
+#define GLIDE_SIZE   1
+#define GLIDE_COLOR  2
+#define GLIDE_KINDS  3
+#define GLIDE_FPS    60   // frame rate cap for all glides together
+
+// output filters: event types, and modifier keys which must be held
+#define FILTER_BUTTON  1
+#define FILTER_DRAG    2
+#define FILTER_DELTAS  4
+#define FILTER_HOVER   8
+#define FILTER_EVENTS  15
+#define FILTER_SHIFT   1
+#define FILTER_ALT     2
+
+// output targets of an event, see mousepad_targets()
+#define EMIT_OUTLET  1    // outlet has connections
+#define EMIT_SEND    2    // send name has a receiver
+#define EMIT_FIXED   4    // properties dialog is listening
+
+#define COLORCACHEBITS 6  // 64 recent color symbols kept by the class
+#define COLORCACHE   (1 << COLORCACHEBITS)
+
 #define IS_A_FLOAT(atom,index) ((atom+index)->a_type == A_FLOAT)
 #define IS_A_SYMBOL(atom,index) ((atom+index)->a_type == A_SYMBOL)
 
@@ -86,6 +148,9 @@ static t_symbol* symButton; // selector symbols for output messages
 static t_symbol* symDrag;
 static t_symbol* symHover;
 static t_symbol* symDeltas;
+static t_symbol* symPointer;
+static t_symbol* symX;      // symbols for saving
+static t_symbol* symObj;
 
 
 // ---------- mousepad ---------------------------------------------------------
@@ -95,7 +160,18 @@ t_widgetbehavior mousepad_widgetbehavior;
 static t_class *mousepad_class;
 
 
+// One glide animation. Up to 3 values are interpolated: x y for position,
+// width height for size, r g b for color.
 typedef struct
+{
+    double    starttime;              // logical time at glide start
+    double    duration;               // glide time in ms
+    int       from[3];                // nominal start values
+    int       to[3];                  // nominal end values
+} t_glide;
+
+
+typedef struct _mousepad
 {
     t_object  obj;
     t_glist*  glist;                  // owning glist or 'canvas'
@@ -103,13 +179,33 @@ typedef struct
     int       height;                 // object rectangle height (nominal)
     int       xval;                   // mouse x relative to object (nominal)
     int       yval;                   // mouse y relative to object (nominal)
+    int       deltax;                 // x change by last mouse event
+    int       deltay;                 // y change by last mouse event
     int       pixw;                   // width expressed in true pixels
     int       pixh;                   // height expressed in true pixels
     int       zoomfactor;             // zoom factor of owning glist (1 or 2)
+    int       pixvalid;               // 1 if pixx and pixy are up to date
+    int       pixx;                   // cached text_xpix() result
+    int       pixy;                   // cached text_ypix() result
+    t_glist*  pixglist;               // glist for which pixx, pixy were found
     int       buttonstate;            // mouse button state 1 or 0
     int       intcolor;               // fill color expressed as integer
     
+    // output filters, checked before any output
+    int       filterevents;           // FILTER_* bits of events to output
+    int       filtermods;             // FILTER_SHIFT | FILTER_ALT to be held
+    int       filterdeadzone;         // minimum movement (nominal)
+    int       filterchange;           // 1 if only changed values are output
+    int       modspass;               // 1 if modifier keys pass the filter,
+                                      // latched at button down
+    int       pressed;                // 1 if button down was output
+    int       lastx;                  // last output x y (nominal)
+    int       lasty;
+    int       pendingx;               // drag deltas not output yet
+    int       pendingy;
+    
     // send & receive parameters
+    int       sendable;               // 1 if send name is not "empty"
     t_symbol* sendname;               // settable send name (expanded)
     t_symbol* receivename;            // settable receive name (expanded)
     t_symbol* sendname_unexpanded;
@@ -118,11 +214,69 @@ typedef struct
     t_symbol* sendname_fixed;         // "from-mousepad-<objID>"
     t_symbol* receivename_fixed;      // "to-mousepad-<objID>"
     
+    // replication to another Pd process
+    int       replicating;            // 1 if linked in replication list
+    int       repldirty;              // REPL_* fields set since last record
+    int       replfull;               // REPL_* fields to send even if unchanged
+    int       replsent[REPL_VALUES];  // field values in last record
+    t_symbol* replchannel;            // channel name carried in each record
+    struct sockaddr_in repladdr;      // destination: localhost and port
+    struct _mousepad* replnext;       // next in list of replicating objects
+    
+    // pointer state export to shared memory
+    t_mousepad_shm* shm;              // mapped shared memory block or NULL
+    t_symbol* shmname;                // name of shared memory object
+    t_mousepad_state shmstate;        // local copy of published state
+    
+    // position indicator, redrawn at most once per GUI flush
+    int       cursor;                 // 1 if crosshair is shown
+    int       traillength;            // number of trail points, 0 if no trail
+    int       trailhead;              // index of newest point in ring buffer
+    int       trailcount;             // valid points in ring buffer
+    int       trailx[TRAILMAX];       // mouse x y history (true pixels)
+    int       traily[TRAILMAX];
+    
+    // zoom notification, sent once per canvas by class-wide clock
+    int       zoompending;            // 1 if in list of pending notifications
+    struct _mousepad* zoomnext;       // next in list of pending notifications
+    
+    // glide animations, stepped by class-wide clock
+    int       glides;                 // bit (1 << GLIDE_*) set if active
+    int       glidelisted;            // 1 if in list of gliding objects
+    t_glide   glide[GLIDE_KINDS];
+    struct _mousepad* glidenext;      // next in list of gliding objects
+    
     t_clock*  initclock;
     t_atom    out[3];
 } t_mousepad;
 
 
+// All mousepads with active glides are linked in a list which is walked by
+// one clock at the capped frame rate, so that each object is redrawn at most
+// once per frame, however many glides it has.
+static t_mousepad* glidelist;
+static t_clock*    glideclock;
+
+
+// Mousepads which had a zoom change are linked in a list, which is flushed by
+// a zero delay clock. See mousepad_zoom().
+static t_mousepad* zoomlist;
+static t_clock*    zoomclock;
+
+
+// All replicating mousepads share one UDP socket, open while the list of
+// replicating objects is not empty. See mousepad_repl_flush().
+static t_mousepad* repllist;
+static int         replfd = -1;
+static t_clock*    replclock;         // flushes dirty fields once per tick
+static t_clock*    replrefreshclock;  // schedules full state records
+
+
+// Changed whenever a receive name is bound or unbound, so that state readers
+// know when to look up their mousepad again. See mousepad_state_find().
+static unsigned int receivegeneration;
+
+
 
 ////////////////////////////////////////////////////////////////////////////////
 ///////////// generalized functions ////////////////////////////////////////////
@@ -170,6 +324,35 @@ t_symbol* int2hexcolor(int intcolor)
 }
 
 
+// Small direct mapped cache of color symbols, shared by all instances. Saving
+// many objects with the same few colors then finds the symbol without
+// formatting and hashing the name again. A color is only turned into a symbol
+// when needed for saving, not when set, so that transient colors of glides
+// and gradients do not end up in Pd's symbol table.
+
+static struct
+{
+    int       intcolor;
+    t_symbol* symbol;                 // null if entry unused
+} colorcache[COLORCACHE];
+
+
+t_symbol* color2symbol(int intcolor)
+{
+    // multiplicative hash, the high bits depend on all color components
+    unsigned int index = ((unsigned int)intcolor * 2654435761u)
+        >> (32 - COLORCACHEBITS);
+    
+    if(!colorcache[index].symbol || colorcache[index].intcolor != intcolor)
+    {
+        colorcache[index].intcolor = intcolor;
+        colorcache[index].symbol   = int2hexcolor(intcolor);
+    }
+    
+    return colorcache[index].symbol;
+}
+
+
 // Symbol to int conversion for web color names with 3 or 6 hex digits.
 // For other number of hex digits, result is unspecified but not harmful.
 // hexcolor[0] is assumed '#' but not checked here.
@@ -206,22 +389,282 @@ int hexcolor2int(const char hexcolor[])
 }
 
 
+// Interpolate between two colors per 8 bit component, 'pos' ranging 0 till 1.
+int color_mix(int color1, int color2, double pos)
+{
+    int i, mix = 0;
+    
+    if(pos < 0) pos = 0;
+    if(pos > 1) pos = 1;
+    
+    for(i = 16; i >= 0; i -= 8)
+    {
+        int c1 = (color1 >> i) & 0xFF;
+        int c2 = (color2 >> i) & 0xFF;
+        mix |= ((int)floor(c1 + (c2 - c1) * pos + 0.5)) << i;
+    }
+    
+    return mix;
+}
+
+
+static int color_clip(double component)
+{
+    int c = (int)floor(component * 255. + 0.5);
+    return (c < 0) ? 0 : (c > 255) ? 255 : c;
+}
+
+
+// Hue in degrees, wrapped to 0 till 360. Saturation and value 0 till 1.
+int hsv2color(double h, double s, double v)
+{
+    double r, g, b, f, p, q, t;
+    
+    h = fmod(h, 360.);
+    if(h < 0) h += 360.;
+    s = (s < 0) ? 0 : (s > 1) ? 1 : s;
+    
+    h /= 60.;
+    f = h - floor(h);
+    p = v * (1. - s);
+    q = v * (1. - s * f);
+    t = v * (1. - s * (1. - f));
+    
+    switch((int)h)
+    {
+        case 0:  r = v; g = t; b = p; break;
+        case 1:  r = q; g = v; b = p; break;
+        case 2:  r = p; g = v; b = t; break;
+        case 3:  r = p; g = q; b = v; break;
+        case 4:  r = t; g = p; b = v; break;
+        default: r = v; g = p; b = q; break;
+    }
+    
+    return (color_clip(r) << 16) | (color_clip(g) << 8) | color_clip(b);
+}
+
+
+// Hue in degrees, saturation and lightness 0 till 1. Converted via hsv.
+int hsl2color(double h, double s, double l)
+{
+    l = (l < 0) ? 0 : (l > 1) ? 1 : l;
+    s = (s < 0) ? 0 : (s > 1) ? 1 : s;
+    
+    double v = l + s * ((l < 0.5) ? l : (1. - l));
+    double sv = (v > 0) ? 2. * (1. - l / v) : 0;
+    
+    return hsv2color(h, sv, v);
+}
+
+
+// Palettes are named color tables shared by all instances for the lifetime of
+// the class. A position 0 till 1 in the palette maps to a color interpolated
+// between evenly spaced entries.
+
+typedef struct _palette
+{
+    t_symbol* name;
+    int       size;                   // number of colors
+    int*      colors;
+    struct _palette* next;
+} t_palette;
+
+
+static t_palette* palettelist;
+
+
+static t_palette* palette_find(t_symbol* name)
+{
+    t_palette* palette;
+    
+    for(palette = palettelist; palette; palette = palette->next)
+        if(palette->name == name) return palette;
+    
+    return 0;
+}
+
+
+static int palette_color(t_palette* palette, double pos)
+{
+    if(palette->size == 1) return palette->colors[0];
+    
+    if(pos < 0) pos = 0;
+    if(pos > 1) pos = 1;
+    
+    double index = pos * (palette->size - 1);
+    int i = (int)index;
+    if(i >= palette->size - 1) return palette->colors[palette->size - 1];
+    
+    return color_mix(palette->colors[i], palette->colors[i + 1], index - i);
+}
+
+
+// Color from float or symbol atom, as accepted by method 'color'. A symbol
+// naming a palette is followed by a position in the palette. Returns the
+// default color for anything else.
+int atom2color(int argc, t_atom *argv)
+{
+    int intcolor = DEFCOLOR;
+    
+    if(!argc) return intcolor;
+    
+    if(IS_A_FLOAT(argv, 0)) 
+    {
+        intcolor = (int)atom_getfloatarg(0, 1, argv);
+        intcolor &= 0xFFFFFF;
+    }
+    
+    else if(IS_A_SYMBOL(argv, 0))
+    {
+        t_symbol* hexcolor;
+        hexcolor = atom_getsymbolarg(0, 1, argv);
+        t_palette* palette;
+        if(hexcolor->s_name[0] == '#')
+            intcolor = hexcolor2int(hexcolor->s_name);
+        else if((palette = palette_find(hexcolor)))
+            intcolor = palette_color(palette, atom_getfloatarg(1, argc, argv));
+    }
+    
+    return intcolor;
+}
+
+
+// Define or redefine palette with colors as accepted by atom2color().
+static void palette_define(t_symbol* name, int argc, t_atom *argv)
+{
+    t_palette* palette = palette_find(name);
+    int i;
+    
+    if(!palette)
+    {
+        palette = (t_palette*)getbytes(sizeof(t_palette));
+        palette->name   = name;
+        palette->size   = 0;
+        palette->colors = 0;
+        palette->next   = palettelist;
+        palettelist     = palette;
+    }
+    
+    palette->colors = (int*)resizebytes(palette->colors,
+        palette->size * sizeof(int), argc * sizeof(int));
+    palette->size = argc;
+    
+    for(i = 0; i < argc; i++) palette->colors[i] = atom2color(1, argv + i);
+}
+
+
+// Integers in replication packets are 32 bit signed, big endian (network byte
+// order). Functions return the index after the written or read field.
+
+static int packet_putint(unsigned char packet[], int index, int value)
+{
+    unsigned int u = (unsigned int)value;
+    
+    packet[index]     = (u >> 24) & 0xFF;
+    packet[index + 1] = (u >> 16) & 0xFF;
+    packet[index + 2] = (u >> 8) & 0xFF;
+    packet[index + 3] = u & 0xFF;
+    
+    return index + 4;
+}
+
+
+static int packet_getint(const unsigned char packet[], int index, int* value)
+{
+    unsigned int u = ((unsigned int)packet[index] << 24)
+                   | ((unsigned int)packet[index + 1] << 16)
+                   | ((unsigned int)packet[index + 2] << 8)
+                   | (unsigned int)packet[index + 3];
+    *value = (int)u;
+    
+    return index + 4;
+}
+
+
+static void socket_close(int fd)
+{
+#ifdef MSW
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+
 // ---------- drawing calls for tk ---------------------------------------------
 
 // Generic functions for drawing and configuring rectangles (base, IOlets etc.)
 // Argument 'obj' is the unique object ID: its pointer cast to t_int.
 // Character 'part' refers to: base rectangle, inlet or outlet.
-// Argument 'w' is outline width.
-// Array pix[] contains coordinates x1, y1, x2, y2.
+// Argument 'rects' is a 'multi-rect' combination of part bits.
+
+
+// Tcl procs installed once by draw_setup(). Base, inlet and outlet rectangles
+// are derived GUI-side from the base rectangle position and size, so that a
+// create, move or erase of all rectangles takes only one short command.
+// Tags are the object ID followed by the part number as character, like in
+// the other drawing calls.
+static const char* draw_procs =
+    "namespace eval ::mousepad {}\n"
+    "proc ::mousepad::rect {part x y w h zoom} {\n"
+    "    set iow [expr {%d * $zoom}]\n"
+    "    set ioh [expr {%d * $zoom}]\n"
+    "    switch -- $part {\n"
+    "        %d {return [list $x $y [expr {$x + $w}] [expr {$y + $h}]]}\n"
+    "        %d {return [list $x $y [expr {$x + $iow}] [expr {$y + $ioh}]]}\n"
+    "        %d {return [list $x [expr {$y + $h - $ioh}] [expr {$x + $iow}] [expr {$y + $h}]]}\n"
+    "    }\n"
+    "}\n"
+    "proc ::mousepad::draw {canvas obj rects x y w h zoom color} {\n"
+    "    foreach part {%d %d %d} {\n"
+    "        if {$rects & $part} {\n"
+    "            $canvas create rectangle [::mousepad::rect $part $x $y $w $h $zoom] \\\n"
+    "                -width $zoom -tags $obj[format %%c $part]\n"
+    "        }\n"
+    "    }\n"
+    "    if {$rects & %d} {$canvas itemconfigure $obj[format %%c %d] -fill $color}\n"
+    "}\n"
+    "proc ::mousepad::move {canvas obj rects x y w h zoom} {\n"
+    "    foreach part {%d %d %d} {\n"
+    "        if {$rects & $part} {\n"
+    "            $canvas coords $obj[format %%c $part] [::mousepad::rect $part $x $y $w $h $zoom]\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "proc ::mousepad::erase {canvas obj rects} {\n"
+    "    foreach part {%d %d %d} {\n"
+    "        if {$rects & $part} {$canvas delete $obj[format %%c $part]}\n"
+    "    }\n"
+    "}\n";
+
+
+static void draw_setup(void)
+{
+    sys_vgui(draw_procs, IOWIDTH, IOHEIGHT, BASE, INLET, OUTLET,
+        BASE, INLET, OUTLET, BASE, BASE,
+        BASE, INLET, OUTLET,
+        BASE, INLET, OUTLET);
+}
+
 
-static void draw_rect(t_canvas* canv, t_int obj, char part, int pix[], int w, int isnew)
+// Base rectangle has top left corner x y and size w h in true pixels. Argument
+// 'zoom' is outline width and IOlet size factor. Color is fill color of base
+// rectangle, used only when creating.
+static void draw_rects(t_canvas* canv, t_int obj, int rects, int x, int y,
+                        int w, int h, int zoom, int color, int isnew)
 {
     if(isnew)
-        sys_vgui(".x%lx.c create rectangle %d %d %d %d -width %d -tags %lx%c\n",
-                canv, pix[0], pix[1], pix[2], pix[3], w, obj, part);
+        sys_vgui("::mousepad::draw .x%lx.c %lx %d %d %d %d %d %d #%06x\n",
+                canv, obj, rects, x, y, w, h, zoom, color);
     else
-        sys_vgui(".x%lx.c coords %lx%c %d %d %d %d\n",
-                canv, obj, part, pix[0], pix[1], pix[2], pix[3]);
+        sys_vgui("::mousepad::move .x%lx.c %lx %d %d %d %d %d %d\n",
+                canv, obj, rects, x, y, w, h, zoom);
+}
+
+
+static void draw_eraserects(t_canvas* canv, t_int obj, int rects)
+{
+    sys_vgui("::mousepad::erase .x%lx.c %lx %d\n", canv, obj, rects);
 }
 
 
@@ -246,6 +689,59 @@ static void draw_erase(t_canvas* canv, t_int obj, char part)
 }
 
 
+// Commands for many objects can be collected in a batch, which is sent to
+// the GUI in one go.
+
+typedef struct
+{
+    char*     buf;
+    int       size;                   // allocated bytes
+    int       len;                    // used bytes, excluding terminator
+} t_drawbatch;
+
+
+// Append formatted text, growing the buffer as needed.
+static void drawbatch_addv(t_drawbatch* batch, const char* fmt, ...)
+{
+    va_list args;
+    int n;
+    
+    va_start(args, fmt);
+    n = vsnprintf(batch->buf + batch->len, batch->size - batch->len, fmt, args);
+    va_end(args);
+    
+    if(batch->len + n + 1 > batch->size)
+    {
+        int newsize = 2 * (batch->len + n + 1);
+        batch->buf  = (char*)resizebytes(batch->buf, batch->size, newsize);
+        batch->size = newsize;
+        
+        va_start(args, fmt);
+        vsnprintf(batch->buf + batch->len, batch->size - batch->len, fmt, args);
+        va_end(args);
+    }
+    
+    batch->len += n;
+}
+
+
+static void drawbatch_fillcolor(t_drawbatch* batch, t_canvas* canv, t_int obj,
+                                    char part, int color)
+{
+    drawbatch_addv(batch, ".x%lx.c itemconfigure %lx%c -fill #%06x\n",
+        canv, obj, part, color);
+}
+
+
+static void drawbatch_send(t_drawbatch* batch)
+{
+    if(batch->len) sys_gui(batch->buf);
+    if(batch->buf) freebytes(batch->buf, batch->size);
+    batch->buf  = 0;
+    batch->size = batch->len = 0;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////// mousepad specific functions /////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -258,193 +754,682 @@ static void draw_erase(t_canvas* canv, t_int obj, char part)
 // most methods individually because of the difference between widgets.
 
 
-// ----------- pixel calculator ------------------------------------------------
-
-// Calculate pixel coordinates of rectangles that must be (re)drawn.
-// Functions text_*pix() (in g_graph.c) will compensate parent offset.
-
-static void mousepad_draw(t_mousepad *mp, int isnew, int rects)
+// ----------- replication ----------------------------------------------------
+
+// A replicating mousepad sends its state to a [mousepad-mirror] in another Pd
+// process over UDP on localhost. Fields are flagged in 'repldirty' when set,
+// and all replicating objects are flushed by one zero delay clock, so that all
+// changes within one logical time tick are coalesced: one record per object,
+// and as many records per packet as fit, for objects replicating to the same
+// port. The list is kept grouped by port for this. Fields with the same values
+// as in the previous record are left out. This also ends echoes when two
+// processes replicate to each other: a mirrored value comes back unchanged.
+// 
+// Every REPL_REFRESH milliseconds all objects send records with all fields, so
+// that a mirror started after the mousepad gets the full state. Layout:
+// 
+// packet: "MPR2" | record | record ...
+// record: mask (1 byte) | name length (1 byte) | channel name | fields
+// 
+// Fields are present in order of their REPL_* bit, each as 1 or 2 integers
+// with nominal (zoom factor 1) values. See packet_putint() for integer format.
+
+
+static void mousepad_repl_mark(t_mousepad *mp, int fields)
 {
-    if((!isnew) & (!glist_isvisible(mp->glist))) return;
+    if(!mp->replicating) return;
     
-    t_canvas* canv = glist_getcanvas(mp->glist);
-    int zoom       = mp->zoomfactor;
-    int xpos       = text_xpix(&mp->obj, mp->glist);
-    int ypos       = text_ypix(&mp->obj, mp->glist);
-    int width      = mp->pixw;          // pixw and pixh do match zoom factor...
-    int height     = mp->pixh;
-    int iowidth    = IOWIDTH * zoom;    // ...but IOWIDTH and IOHEIGHT not
-    int ioheight   = IOHEIGHT * zoom;
-    
-    if(!rects)  // figure out what to draw if not specified
-    {
-        rects = BASE;
-        if(mp->sendname == symEmpty) rects |= INLET;
-        if(mp->receivename == symEmpty) rects |= OUTLET;
-    }
-    
-    if(rects & BASE)
-    {
-        int base[4];
-        base[0] = xpos;
-        base[1] = ypos;
-        base[2] = xpos + width;
-        base[3] = ypos + height;
-        draw_rect(canv, (t_int)mp, BASE, base, zoom, isnew);
-    }
-    
-    if(rects & INLET)
-    {
-        int inlet[4];
-        inlet[0] = xpos;
-        inlet[1] = ypos;
-        inlet[2] = xpos + iowidth;
-        inlet[3] = ypos + ioheight;
-        draw_rect(canv, (t_int)mp, INLET, inlet, zoom, isnew);
-    }
-    
-    if(rects & OUTLET)
-    {
-        int outlet[4];
-        outlet[0] = xpos;
-        outlet[1] = ypos + height - ioheight;
-        outlet[2] = xpos + iowidth;
-        outlet[3] = ypos + height;
-        draw_rect(canv, (t_int)mp, OUTLET, outlet, zoom, isnew);
-    }
-    
-    if(isnew) draw_fillcolor(canv, (t_int)mp, BASE, mp->intcolor);
-    else canvas_fixlinesfor(mp->glist, (t_text*)mp);
+    if(!mp->repldirty) clock_delay(replclock, 0);
+    mp->repldirty |= fields;
 }
 
 
-// called by mousepad_send() and mousepad_receive() if send/receivable changes
-static void mousepad_change_io(t_mousepad *mp, int change, int iolet)
+// send all fields at the next flush
+static void mousepad_repl_full(t_mousepad *mp)
 {
-    if(!glist_isvisible(mp->glist)) return;
-    
-    t_canvas* canv = glist_getcanvas(mp->glist);
-    
-    if(change == 1) mousepad_draw(mp, 1, iolet);
-    else if(change == -1) draw_erase(canv, (t_int)mp, iolet);
+    mp->replfull = REPL_ALL;
+    mousepad_repl_mark(mp, REPL_ALL);
 }
 
 
-// ----------- t_widgetbehaviour callback functions ---------------------------- 
+static void mousepad_repl_refresh(void *dummy)
+{
+    t_mousepad* mp;
+    
+    for(mp = repllist; mp; mp = mp->replnext) mousepad_repl_full(mp);
+    if(repllist) clock_delay(replrefreshclock, REPL_REFRESH);
+}
 
 
-void mousepad_vis(t_gobj *z, t_glist *glist, int vis)
+// Append the record of one object to the packet at index n. Returns the new
+// index, which is n if no field changed.
+static int mousepad_repl_record(t_mousepad *mp, unsigned char packet[], int n)
 {
-    t_mousepad *mp = (t_mousepad*)z;
-    t_canvas *canv = glist_getcanvas(glist);
-    
-    if(vis) 
+    static const int fieldsize[REPL_FIELDS] = {2, 1, 2, 2, 1};
+    int values[REPL_VALUES];
+    int mask    = mp->repldirty;
+    int full    = mp->replfull;
+    int zoom    = mp->zoomfactor;
+    int namelen = strlen(mp->replchannel->s_name);
+    int i, j, v;
+    
+    mp->repldirty = 0;
+    mp->replfull  = 0;
+    if(namelen > 255) namelen = 255;
+    
+    // nominal values of all fields, in order of their REPL_* bit
+    values[0] = mp->xval / zoom;
+    values[1] = mp->yval / zoom;
+    values[2] = mp->buttonstate;
+    values[3] = mp->obj.te_xpix / zoom;
+    values[4] = mp->obj.te_ypix / zoom;
+    values[5] = mp->width;
+    values[6] = mp->height;
+    values[7] = mp->intcolor;
+    
+    // leave out fields which did not change since the last packet
+    for(i = 0, v = 0; i < REPL_FIELDS; v += fieldsize[i++])
     {
-        const int isnew = 1;
-        mousepad_draw(mp, isnew, 0);
+        int changed = 0;
+        
+        for(j = 0; j < fieldsize[i]; j++)
+            changed |= (values[v+j] != mp->replsent[v+j]);
+        
+        if(!changed && !(full & (1 << i))) mask &= ~(1 << i);
     }
+    if(!mask) return (n);
     
-    else
+    packet[n]   = (unsigned char)mask;
+    packet[n+1] = (unsigned char)namelen;
+    memcpy(packet + n + 2, mp->replchannel->s_name, namelen);
+    n += 2 + namelen;
+    
+    for(i = 0, v = 0; i < REPL_FIELDS; v += fieldsize[i++])
     {
-        draw_erase(canv, (t_int)mp, BASE);
-        if(mp->sendname == symEmpty)    draw_erase(canv, (t_int)mp, INLET);
-        if(mp->receivename == symEmpty) draw_erase(canv, (t_int)mp, OUTLET);
-        sys_unqueuegui(z);
+        if(!(mask & (1 << i))) continue;
+        
+        for(j = 0; j < fieldsize[i]; j++)
+        {
+            n = packet_putint(packet, n, values[v+j]);
+            mp->replsent[v+j] = values[v+j];
+        }
     }
+    
+    return (n);
 }
 
 
-void mousepad_displace(t_gobj *z, t_glist *glist, int dx, int dy)
+static void mousepad_repl_send(unsigned char packet[], int n, t_mousepad *dest)
 {
-    const int isnew = 0;
-    t_mousepad *mp = (t_mousepad *)z;
-    
-    mp->obj.te_xpix += dx;
-    mp->obj.te_ypix += dy;
-    
-    mousepad_draw(mp, isnew, 0);
+    sendto(replfd, (const char*)packet, n, 0,
+        (struct sockaddr*)&dest->repladdr, sizeof(dest->repladdr));
 }
 
 
-void mousepad_select(t_gobj *z, t_glist *glist, int selected)
+static void mousepad_repl_flush(void *dummy)
 {
-    t_mousepad *mp = (t_mousepad *)z;
-    int outlinecolor = COLOR_NORMAL;
-    if(selected) outlinecolor = COLOR_SELECTED;
+    unsigned char packet[REPL_MAXPACKET];
+    t_mousepad* mp;
+    t_mousepad* dest = 0;             // first object in packet, for address
+    int n = 0;
     
-    if(glist_isvisible(glist))
+    for(mp = repllist; mp; mp = mp->replnext)
     {
-        t_canvas* canv = glist_getcanvas(glist);
-        draw_outlinecolor(canv, (t_int)mp, BASE, outlinecolor);
+        if(!mp->repldirty) continue;
+        
+        // a packet goes to one port, start another one if it is full
+        if(dest && ((n + REPL_MAXRECORD > REPL_MAXPACKET) ||
+            (mp->repladdr.sin_port != dest->repladdr.sin_port)))
+        {
+            mousepad_repl_send(packet, n, dest);
+            dest = 0;
+        }
+        
+        if(!dest)
+        {
+            memcpy(packet, REPL_MAGIC, 4);
+            n = 4;
+        }
+        
+        int next = mousepad_repl_record(mp, packet, n);
+        if(next > n && !dest) dest = mp;
+        n = next;
     }
+    
+    if(dest) mousepad_repl_send(packet, n, dest);
 }
 
 
-void mousepad_delete(t_gobj *z, t_glist *glist)
+// Link a replicating object in the list, next to objects with the same port.
+static void mousepad_repl_start(t_mousepad *mp)
 {
-    canvas_deletelinesfor(glist, (t_text*)z);
+    t_mousepad** link = &repllist;
+    t_mousepad* other;
+    
+    for(other = repllist; other; other = other->replnext)
+        if(other->repladdr.sin_port == mp->repladdr.sin_port)
+        {
+            link = &other->replnext;
+            break;
+        }
+    
+    if(!repllist) clock_delay(replrefreshclock, REPL_REFRESH);
+    
+    mp->replnext    = *link;
+    *link           = mp;
+    mp->replicating = 1;
+    mousepad_repl_full(mp);
 }
 
-// Functions text_*pix() (in g_graph.c) compensate for parent offset.
-static void mousepad_getrect(t_gobj *z, t_glist *glist,
-                                int *xp1, int *yp1, int *xp2, int *yp2)
+
+// Unlink from the list, and close the socket after the last object.
+static void mousepad_repl_stop(t_mousepad *mp)
 {
-    t_mousepad *mp = (t_mousepad *)z;
+    t_mousepad** link = &repllist;
     
-    *xp1 = text_xpix(&mp->obj, glist);
-    *yp1 = text_ypix(&mp->obj, glist);
+    if(!mp->replicating) return;
     
-    *xp2 = *xp1 + mp->pixw;
-    *yp2 = *yp1 + mp->pixh;
+    while(*link != mp) link = &(*link)->replnext;
+    *link = mp->replnext;
+    mp->replicating = 0;
+    mp->repldirty   = 0;
+    mp->replfull    = 0;
+    
+    if(repllist) return;
+    
+    clock_unset(replclock);
+    clock_unset(replrefreshclock);
+    socket_close(replfd);
+    replfd = -1;
 }
 
 
-// --------- other callback functions ------------------------------------------
+// ----------- shared memory export ---------------------------------------------
 
+// Publish pointer state after each mouse event, if exported. Values are
+// normalized here. The block layout and sequence lock are defined in
+// mousepad-shm.h.
 
-static void mousepad_save(t_gobj *z, t_binbuf *b)
+
+static void mousepad_shm_publish(t_mousepad *mp)
 {
-    t_mousepad *mp = (t_mousepad *)z;
+    if(!mp->shm) return;
     
-    // normalize position to zoom factor 1
-    int xpos   = (int)mp->obj.te_xpix / mp->zoomfactor;
-    int ypos   = (int)mp->obj.te_ypix / mp->zoomfactor;
+    int zoom = mp->zoomfactor;
+    t_mousepad_state* state = &mp->shmstate;
     
-    binbuf_addv(b, "ssiisiisss", gensym("#X"), gensym("obj"),
-        xpos, ypos,
-        atom_getsymbol(binbuf_getvec(mp->obj.te_binbuf)),
-        mp->width, mp->height, 
-        mp->sendname_unexpanded, mp->receivename_unexpanded,
-        int2hexcolor(mp->intcolor)); // store color as symbol
-    binbuf_addv(b, ";");
+    state->xval        = mp->xval / zoom;
+    state->yval        = mp->yval / zoom;
+    state->buttonstate = mp->buttonstate;
+    state->deltax      = mp->deltax / zoom;
+    state->deltay      = mp->deltay / zoom;
+    state->stamp++;
+    state->logicaltime = clock_getlogicaltime();
+    
+    mousepad_shm_write(mp->shm, state);
 }
 
 
-static void mousepad_motion(t_mousepad *mp, t_floatarg dx, t_floatarg dy)
+static void mousepad_shm_close(t_mousepad *mp)
 {
-    int deltax = (t_int)dx;
-    int deltay = (t_int)dy;
+#ifndef MSW
+    if(!mp->shm) return;
     
-    if ((deltax | deltay) == 0) return; // do not send output if nothing changed
+    munmap(mp->shm, sizeof(t_mousepad_shm));
+    shm_unlink(mp->shmname->s_name);
+    mp->shm = 0;
+#endif
+}
+
+
+// ----------- pixel position cache ---------------------------------------------
+
+// Functions text_*pix() (in g_graph.c) compensate for parent offset, walking
+// up through graph-on-parent glists. The result is cached for hit-testing and
+// redrawing, and invalidated when the object is moved, when zoom changes and
+// when it is made visible. The latter covers changes of parent GOP position
+// or bounds, because Pd then redraws the children of the GOP via their vis
+// functions. A hidden GOP can move without vis calls, therefore [get pos(
+// recomputes the position.
+
+
+static void mousepad_pixpos(t_mousepad *mp, t_glist *glist, int *xpos, int *ypos)
+{
+    if(!mp->pixvalid || (glist != mp->pixglist))
+    {
+        mp->pixx     = text_xpix(&mp->obj, glist);
+        mp->pixy     = text_ypix(&mp->obj, glist);
+        mp->pixglist = glist;
+        mp->pixvalid = 1;
+    }
+    
+    *xpos = mp->pixx;
+    *ypos = mp->pixy;
+}
+
+
+// ----------- position indicator ---------------------------------------------
+
+// Crosshair and trail are lines inside the base rectangle. Mouse events only
+// record the position and queue a redraw, which Pd calls at the next GUI
+// flush. So however high the event rate, there is at most one batch of coords
+// commands per flush. The trail is split in bands which fade into the fill
+// color, oldest band faintest.
+
+
+static void mousepad_indicator_redraw(t_gobj *z, t_glist *glist)
+{
+    t_mousepad* mp = (t_mousepad*)z;
+    t_drawbatch batch = {0, 0, 0};
+    
+    if(!glist_isvisible(mp->glist)) return;
+    
+    t_canvas* canv = glist_getcanvas(mp->glist);
+    int xpos, ypos;
+    mousepad_pixpos(mp, mp->glist, &xpos, &ypos);
+    int x      = xpos + mp->xval;
+    int y      = ypos + mp->yval;
+    
+    // keep indicator inside the base rectangle
+    if(x < xpos) x = xpos;
+    if(x > xpos + mp->pixw) x = xpos + mp->pixw;
+    if(y < ypos) y = ypos;
+    if(y > ypos + mp->pixh) y = ypos + mp->pixh;
+    
+    if(mp->cursor)
+        drawbatch_addv(&batch, ".x%lx.c coords %lx%c %d %d %d %d %d %d %d %d %d %d\n",
+            canv, (t_int)mp, CURSOR, xpos, y, xpos + mp->pixw, y, x, y,
+            x, ypos, x, ypos + mp->pixh);
+    
+    if(mp->traillength)
+    {
+        int count = mp->trailcount;
+        int band, i;
+        
+        // bands share end points, band 0 has the oldest points
+        for(band = 0; band < TRAILBANDS; band++)
+        {
+            int first = (count - 1) * band / TRAILBANDS;
+            int last  = (count - 1) * (band + 1) / TRAILBANDS;
+            
+            drawbatch_addv(&batch, ".x%lx.c coords %lx%c", canv, (t_int)mp,
+                TRAIL + band);
+            
+            // zero length line if band has no points, draws nothing
+            if(count < 2) drawbatch_addv(&batch, " %d %d %d %d", x, y, x, y);
+            
+            else for(i = first; i <= last; i++)
+            {
+                int index = (mp->trailhead - (count - 1) + i + TRAILMAX) % TRAILMAX;
+                int tx = xpos + mp->trailx[index];
+                int ty = ypos + mp->traily[index];
+                if(tx < xpos) tx = xpos;
+                if(tx > xpos + mp->pixw) tx = xpos + mp->pixw;
+                if(ty < ypos) ty = ypos;
+                if(ty > ypos + mp->pixh) ty = ypos + mp->pixh;
+                drawbatch_addv(&batch, " %d %d", tx, ty);
+                if(first == last) drawbatch_addv(&batch, " %d %d", tx, ty);
+            }
+            
+            drawbatch_addv(&batch, "\n");
+        }
+    }
+    
+    drawbatch_send(&batch);
+}
+
+
+// record pointer position and queue a redraw
+static void mousepad_indicator_update(t_mousepad *mp)
+{
+    if(!(mp->cursor || mp->traillength)) return;
+    
+    if(mp->traillength)
+    {
+        mp->trailhead = (mp->trailhead + 1) % TRAILMAX;
+        mp->trailx[mp->trailhead] = mp->xval;
+        mp->traily[mp->trailhead] = mp->yval;
+        if(mp->trailcount < mp->traillength) mp->trailcount++;
+    }
+    
+    sys_queuegui(mp, mp->glist, mousepad_indicator_redraw);
+}
+
+
+// create indicator lines, which are then positioned by the queued redraw
+static void mousepad_indicator_create(t_mousepad *mp, int parts)
+{
+    t_canvas* canv = glist_getcanvas(mp->glist);
+    int zoom = mp->zoomfactor;
+    int xpos, ypos, band;
+    
+    mousepad_pixpos(mp, mp->glist, &xpos, &ypos);
+    
+    if((parts & CURSOR) && mp->cursor)
+        sys_vgui(".x%lx.c create line %d %d %d %d -width %d -fill #%06x -tags %lx%c\n",
+            canv, xpos, ypos, xpos, ypos, zoom, COLOR_NORMAL, (t_int)mp, CURSOR);
+    
+    if((parts & TRAIL) && mp->traillength)
+        for(band = 0; band < TRAILBANDS; band++)
+        {
+            int color = color_mix(mp->intcolor, COLOR_NORMAL,
+                            (double)(band + 1) / TRAILBANDS);
+            sys_vgui(".x%lx.c create line %d %d %d %d -width %d -fill #%06x -tags %lx%c\n",
+                canv, xpos, ypos, xpos, ypos, zoom, color, (t_int)mp, TRAIL + band);
+        }
+    
+    sys_queuegui(mp, mp->glist, mousepad_indicator_redraw);
+}
+
+
+static void mousepad_indicator_erase(t_mousepad *mp, int parts)
+{
+    t_canvas* canv = glist_getcanvas(mp->glist);
+    int band;
+    
+    if((parts & CURSOR) && mp->cursor) draw_erase(canv, (t_int)mp, CURSOR);
+    
+    if((parts & TRAIL) && mp->traillength)
+        for(band = 0; band < TRAILBANDS; band++)
+            draw_erase(canv, (t_int)mp, TRAIL + band);
+}
+
+
+// ----------- pixel calculator ------------------------------------------------
+
+// Calculate pixel coordinates of the base rectangle, from which the GUI derives
+// all rectangles that must be (re)drawn.
+
+static void mousepad_draw(t_mousepad *mp, int isnew, int rects)
+{
+    if((!isnew) & (!glist_isvisible(mp->glist))) return;
+    
+    t_canvas* canv = glist_getcanvas(mp->glist);
+    int zoom       = mp->zoomfactor;
+    int xpos, ypos;
+    int width      = mp->pixw;          // pixw and pixh do match zoom factor...
+    int height     = mp->pixh;          // ...IOlet sizes are derived GUI-side
+    
+    if(!rects)  // figure out what to draw if not specified
+    {
+        rects = BASE;
+        if(mp->sendname == symEmpty) rects |= INLET;
+        if(mp->receivename == symEmpty) rects |= OUTLET;
+    }
+    
+    mousepad_pixpos(mp, mp->glist, &xpos, &ypos);
+    draw_rects(canv, (t_int)mp, rects, xpos, ypos, width, height, zoom,
+        mp->intcolor, isnew);
+    
+    if(isnew)
+    {
+        if(rects & BASE) mousepad_indicator_create(mp, CURSOR | TRAIL);
+    }
+    
+    else
+    {
+        canvas_fixlinesfor(mp->glist, (t_text*)mp);
+        if(mp->cursor || mp->traillength)
+            sys_queuegui(mp, mp->glist, mousepad_indicator_redraw);
+    }
+}
+
+
+// called by mousepad_send() and mousepad_receive() if send/receivable changes
+static void mousepad_change_io(t_mousepad *mp, int change, int iolet)
+{
+    if(!glist_isvisible(mp->glist)) return;
+    
+    t_canvas* canv = glist_getcanvas(mp->glist);
+    
+    if(change == 1) mousepad_draw(mp, 1, iolet);
+    else if(change == -1) draw_eraserects(canv, (t_int)mp, iolet);
+}
+
+
+// ----------- t_widgetbehaviour callback functions ---------------------------- 
+
+
+void mousepad_vis(t_gobj *z, t_glist *glist, int vis)
+{
+    t_mousepad *mp = (t_mousepad*)z;
+    t_canvas *canv = glist_getcanvas(glist);
+    
+    mp->pixvalid = 0;   // parent GOP may have moved
+    
+    if(vis) 
+    {
+        const int isnew = 1;
+        mousepad_draw(mp, isnew, 0);
+    }
+    
+    else
+    {
+        int rects = BASE;
+        if(mp->sendname == symEmpty)    rects |= INLET;
+        if(mp->receivename == symEmpty) rects |= OUTLET;
+        draw_eraserects(canv, (t_int)mp, rects);
+        mousepad_indicator_erase(mp, CURSOR | TRAIL);
+        sys_unqueuegui(z);
+    }
+}
+
+
+void mousepad_displace(t_gobj *z, t_glist *glist, int dx, int dy)
+{
+    const int isnew = 0;
+    t_mousepad *mp = (t_mousepad *)z;
+    
+    mp->obj.te_xpix += dx;
+    mp->obj.te_ypix += dy;
+    mp->pixvalid = 0;
+    
+    mousepad_draw(mp, isnew, 0);
+    mousepad_repl_mark(mp, REPL_POS);
+}
+
+
+void mousepad_select(t_gobj *z, t_glist *glist, int selected)
+{
+    t_mousepad *mp = (t_mousepad *)z;
+    int outlinecolor = COLOR_NORMAL;
+    if(selected) outlinecolor = COLOR_SELECTED;
+    
+    if(glist_isvisible(glist))
+    {
+        t_canvas* canv = glist_getcanvas(glist);
+        draw_outlinecolor(canv, (t_int)mp, BASE, outlinecolor);
+    }
+}
+
+
+void mousepad_delete(t_gobj *z, t_glist *glist)
+{
+    canvas_deletelinesfor(glist, (t_text*)z);
+}
+
+// Position from cache, see mousepad_pixpos().
+static void mousepad_getrect(t_gobj *z, t_glist *glist,
+                                int *xp1, int *yp1, int *xp2, int *yp2)
+{
+    t_mousepad *mp = (t_mousepad *)z;
+    
+    mousepad_pixpos(mp, glist, xp1, yp1);
+    
+    *xp2 = *xp1 + mp->pixw;
+    *yp2 = *yp1 + mp->pixh;
+}
+
+
+// --------- output ------------------------------------------------------------
+
+// All output goes through mousepad_emit(). The caller first finds the targets
+// with mousepad_targets(), and can skip an event entirely if there are none.
+// An unconnected outlet and an unbound send name are then not even formatted
+// for. Pd does not notify objects when their outlets are (dis)connected or
+// when a receiver binds to their send name, therefore targets are looked up
+// per event: this takes a few pointer reads only. The send name itself is
+// flagged in 'sendable' when set.
+
+
+static int mousepad_targets(t_mousepad *mp, int fixed)
+{
+    t_outlet* outlet;
+    int targets = 0;
+    
+    if(obj_starttraverseoutlet(&mp->obj, &outlet, 0)) targets |= EMIT_OUTLET;
+    if(mp->sendable && mp->sendname->s_thing)          targets |= EMIT_SEND;
+    if(fixed && mp->sendname_fixed->s_thing)           targets |= EMIT_FIXED;
+    
+    return targets;
+}
+
+
+// Emit message with 'argc' atoms from mp->out. Receivers are checked again,
+// because they may be unbound by the output to a previous target.
+static void mousepad_emit(t_mousepad *mp, int targets, t_symbol *selector,
+                            int argc)
+{
+    if(targets & EMIT_OUTLET)
+        outlet_anything(mp->obj.ob_outlet, selector, argc, mp->out);
+    if((targets & EMIT_SEND) && mp->sendname->s_thing)
+        typedmess(mp->sendname->s_thing, selector, argc, mp->out);
+    if((targets & EMIT_FIXED) && mp->sendname_fixed->s_thing)
+        typedmess(mp->sendname_fixed->s_thing, selector, argc, mp->out);
+}
+
+
+// Filters are checked after finding targets and before formatting output.
+// Position filters apply to drag, deltas and hover together: while movement
+// since the last position output stays within the dead zone, or does not
+// change nominal values in change-only mode, nothing is output and deltas
+// accumulate until the next output. Event types which are filtered out do not
+// count as output. The drag at button down is not a movement and is always
+// output, if its type passes.
+
+
+// event type and modifier keys
+static int mousepad_pass(t_mousepad *mp, int event)
+{
+    return ((mp->filterevents & event) && mp->modspass);
+}
+
+
+// Button output, with the modifier keys checked at button down only: a button
+// up is output if and only if the matching button down was, so that receivers
+// never see a press without release, whatever keys are held on release.
+static void mousepad_button_output(t_mousepad *mp, int targets, int buttonstate,
+    int shift, int alt)
+{
+    int output;
+    
+    if(buttonstate)
+        output = mp->pressed = (targets && mousepad_pass(mp, FILTER_BUTTON));
+    else
+    {
+        output = (targets && mp->pressed);
+        mp->pressed = 0;
+    }
+    
+    if(!output) return;
+    
+    SETFLOAT(mp->out, (t_float)buttonstate);
+    SETFLOAT(mp->out+1, (t_float)shift);
+    SETFLOAT(mp->out+2, (t_float)(alt?1:0));
+    mousepad_emit(mp, targets, symButton, 3);
+}
+
+
+// position filters, against the last position output
+static int mousepad_moved(t_mousepad *mp)
+{
+    int dx = abs(mp->xval / mp->zoomfactor - mp->lastx);
+    int dy = abs(mp->yval / mp->zoomfactor - mp->lasty);
+    
+    if(mp->filterchange && !(dx | dy)) return 0;
+    if((dx < mp->filterdeadzone) && (dy < mp->filterdeadzone)) return 0;
+    
+    return 1;
+}
+
+
+// output position xy in 'out', and remember it for the position filters
+static void mousepad_outpos(t_mousepad *mp)
+{
+    mp->lastx = mp->xval / mp->zoomfactor;
+    mp->lasty = mp->yval / mp->zoomfactor;
+    SETFLOAT(mp->out,   (t_float)mp->lastx);
+    SETFLOAT(mp->out+1, (t_float)mp->lasty);
+}
+
+
+// --------- other callback functions ------------------------------------------
+
+
+static void mousepad_save(t_gobj *z, t_binbuf *b)
+{
+    t_mousepad *mp = (t_mousepad *)z;
     
-    int sendable = (mp->sendname != symEmpty);
+    t_atom atoms[10];
+    
+    // normalize position to zoom factor 1
+    int xpos   = (int)mp->obj.te_xpix / mp->zoomfactor;
+    int ypos   = (int)mp->obj.te_ypix / mp->zoomfactor;
+    
+    // atoms are set directly, saving the format parsing of binbuf_addv()
+    SETSYMBOL(atoms,   symX);
+    SETSYMBOL(atoms+1, symObj);
+    SETFLOAT(atoms+2,  (t_float)xpos);
+    SETFLOAT(atoms+3,  (t_float)ypos);
+    SETSYMBOL(atoms+4, atom_getsymbol(binbuf_getvec(mp->obj.te_binbuf)));
+    SETFLOAT(atoms+5,  (t_float)mp->width);
+    SETFLOAT(atoms+6,  (t_float)mp->height);
+    SETSYMBOL(atoms+7, mp->sendname_unexpanded);
+    SETSYMBOL(atoms+8, mp->receivename_unexpanded);
+    SETSYMBOL(atoms+9, color2symbol(mp->intcolor));    // store color as symbol
+    
+    binbuf_add(b, 10, atoms);
+    binbuf_addsemi(b);
+}
+
+
+static void mousepad_motion(t_mousepad *mp, t_floatarg dx, t_floatarg dy)
+{
+    int deltax = (t_int)dx;
+    int deltay = (t_int)dy;
+    
+    if ((deltax | deltay) == 0) return; // do not send output if nothing changed
     
     mp->xval += deltax;
     mp->yval += deltay;
+    mp->deltax = deltax;
+    mp->deltay = deltay;
+    mp->pendingx += deltax;
+    mp->pendingy += deltay;
+    mousepad_repl_mark(mp, REPL_XY);
+    mousepad_shm_publish(mp);
+    mousepad_indicator_update(mp);
+    
+    int targets = mousepad_targets(mp, 0);
+    int drag    = (targets && mousepad_pass(mp, FILTER_DRAG));
+    int deltas  = (targets && mousepad_pass(mp, FILTER_DELTAS));
+    
+    if(!deltas) mp->pendingx = mp->pendingy = 0;    // no deltas to accumulate
+    if(!(drag | deltas) || !mousepad_moved(mp)) return;
     
     // xy relative to gui
-    SETFLOAT(mp->out,   (t_float)(mp->xval / mp->zoomfactor));
-    SETFLOAT(mp->out+1, (t_float)(mp->yval / mp->zoomfactor));
-    outlet_anything(mp->obj.ob_outlet, symDrag, 2, mp->out);
-    if(sendable && mp->sendname->s_thing)
-        typedmess(mp->sendname->s_thing, symDrag, 2, mp->out);
+    mousepad_outpos(mp);
+    if(drag) mousepad_emit(mp, targets, symDrag, 2);
     
-    // xy deltas
-    SETFLOAT(mp->out,   (t_float)(deltax / mp->zoomfactor));
-    SETFLOAT(mp->out+1, (t_float)(deltay / mp->zoomfactor));
-    outlet_anything(mp->obj.ob_outlet, symDeltas, 2, mp->out);
-    if(sendable && mp->sendname->s_thing)
-        typedmess(mp->sendname->s_thing, symDeltas, 2, mp->out);
+    // xy deltas since last output
+    if(deltas)
+    {
+        SETFLOAT(mp->out,   (t_float)(mp->pendingx / mp->zoomfactor));
+        SETFLOAT(mp->out+1, (t_float)(mp->pendingy / mp->zoomfactor));
+        mousepad_emit(mp, targets, symDeltas, 2);
+    }
+    
+    mp->pendingx = mp->pendingy = 0;
 }
 
 
@@ -454,45 +1439,173 @@ static int mousepad_click(t_gobj *z, struct _glist *glist, int xpix, int ypix,
                             int shift, int alt, int dbl, int buttonstate)
 {
     t_mousepad* mp = (t_mousepad *)z;
-    int sendable   = (mp->sendname != symEmpty);
-    int xpos       = text_xpix(&mp->obj, glist);
-    int ypos       = text_ypix(&mp->obj, glist);
+    int targets    = mousepad_targets(mp, 0);
+    int press      = (buttonstate && !mp->buttonstate);
+    int xpos, ypos;
+    
+    mousepad_pixpos(mp, glist, &xpos, &ypos);
+    
+    // modifier keys count while hovering and at button down, a drag keeps them
+    if(!mp->buttonstate)
+    {
+        int modifiers = (shift ? FILTER_SHIFT : 0) | (alt ? FILTER_ALT : 0);
+        mp->modspass = ((modifiers & mp->filtermods) == mp->filtermods);
+    }
   
     if(buttonstate != mp->buttonstate)
     {
-        SETFLOAT(mp->out, (t_float)buttonstate);
-        SETFLOAT(mp->out+1, (t_float)shift);
-        SETFLOAT(mp->out+2, (t_float)(alt?1:0));
-        outlet_anything(mp->obj.ob_outlet, symButton, 3, mp->out);
-        if(sendable && mp->sendname->s_thing)
-            typedmess(mp->sendname->s_thing, symButton, 3, mp->out);
+        mousepad_button_output(mp, targets, buttonstate, shift, alt);
         mp->buttonstate = buttonstate;
+        mp->pendingx = mp->pendingy = 0;
+        mousepad_repl_mark(mp, REPL_BUTTON);
     }
   
-    mp->xval = xpix - xpos;
-    mp->yval = ypix - ypos;
-    SETFLOAT(mp->out, (t_float)(mp->xval / mp->zoomfactor));
-    SETFLOAT(mp->out+1, (t_float)(mp->yval / mp->zoomfactor));
+    int deltax = (xpix - xpos) - mp->xval;
+    int deltay = (ypix - ypos) - mp->yval;
+    mp->xval += deltax;
+    mp->yval += deltay;
+    mp->deltax = deltax;
+    mp->deltay = deltay;
+    mousepad_repl_mark(mp, REPL_XY);
+    mousepad_shm_publish(mp);
+    mousepad_indicator_update(mp);
     
-    // if mouse click, pass motion function pointer and send drag coords
+    // if mouse click, pass motion function pointer
     if(buttonstate)
-    {
         glist_grab(mp->glist, &mp->obj.te_g, (t_glistmotionfn)mousepad_motion, 
             0, (t_float)xpix, (t_float)ypix);
-        outlet_anything(mp->obj.ob_outlet, symDrag, 2, mp->out);
-        if(sendable && mp->sendname->s_thing)
-            typedmess(mp->sendname->s_thing, symDrag, 2, mp->out);
-    }
     
-    // if mouse up, send hover coords
+    if(!targets) return (1);
+    if(!mousepad_pass(mp, buttonstate ? FILTER_DRAG : FILTER_HOVER)) return (1);
+    if(!press && !mousepad_moved(mp)) return (1);
+    
+    // send drag coords if mouse down, hover coords if mouse up
+    mousepad_outpos(mp);
+    mousepad_emit(mp, targets, buttonstate ? symDrag : symHover, 2);
+    
+    return (1);
+}
+
+
+// Remote mouse events, as applied by [mousepad-mirror]. Arguments are nominal
+// values. Output is the same as for local mouse events, except that the
+// modifier keys in 'button' messages are always zero. Modifier keys are not
+// replicated, so remote events are exempt from the modifier key filter.
+static void mousepad_button(t_mousepad *mp, t_floatarg buttonstate)
+{
+    int latched = mp->modspass;     // keep decision of a local button down
+    
+    if((int)buttonstate == mp->buttonstate) return;
+    
+    mp->modspass    = 1;
+    mousepad_button_output(mp, mousepad_targets(mp, 0), (int)buttonstate, 0, 0);
+    mp->modspass    = latched;
+    mp->buttonstate = (int)buttonstate;
+    mp->pendingx    = mp->pendingy = 0;
+    mousepad_repl_mark(mp, REPL_BUTTON);
+    mousepad_shm_publish(mp);
+}
+
+
+static void mousepad_pointer(t_mousepad *mp, t_floatarg x, t_floatarg y)
+{
+    int deltax = (int)x * mp->zoomfactor - mp->xval;
+    int deltay = (int)y * mp->zoomfactor - mp->yval;
+    
+    int latched = mp->modspass;     // keep decision of a local button down
+    
+    if((deltax | deltay) == 0) return;  // e.g. unchanged in a refresh record
+    
+    mp->modspass = 1;
+    
+    if(mp->buttonstate) mousepad_motion(mp, deltax, deltay);
+    
     else
     {
-        outlet_anything(mp->obj.ob_outlet, symHover, 2, mp->out);
-        if(sendable && mp->sendname->s_thing)
-            typedmess(mp->sendname->s_thing, symHover, 2, mp->out);
+        mp->xval += deltax;
+        mp->yval += deltay;
+        mp->deltax = deltax;
+        mp->deltay = deltay;
+        mousepad_repl_mark(mp, REPL_XY);
+        mousepad_shm_publish(mp);
+        mousepad_indicator_update(mp);
+        
+        int targets = mousepad_targets(mp, 0);
+        if(targets && mousepad_pass(mp, FILTER_HOVER) && mousepad_moved(mp))
+        {
+            mousepad_outpos(mp);
+            mousepad_emit(mp, targets, symHover, 2);
+        }
     }
     
-    return (1);
+    mp->modspass = latched;
+}
+
+
+// Zoom notifications are collected and sent after Pd has zoomed all objects.
+// Outlets and properties dialogs get one per object, but a send name gets one
+// per canvas: objects on the same canvas sharing a send name would otherwise
+// flood the receiver with identical messages.
+// Pairs of canvas and send name already notified are kept in an open
+// addressing hash table, sized for all pending objects, so that a zoom of
+// a canvas with many objects stays linear in the number of objects.
+static void mousepad_zoom_flush(void *dummy)
+{
+    typedef struct { t_canvas* canv; t_symbol* sendname; } t_sent;
+    t_sent* sent;
+    t_mousepad* mp;
+    int count = 0, size = 8, i;
+    
+    for(mp = zoomlist; mp; mp = mp->zoomnext) count++;
+    while(size < 2 * count) size *= 2;
+    sent = (t_sent*)getbytes(size * sizeof(t_sent));    // zeroed: all unused
+    
+    while(zoomlist)
+    {
+        mp = zoomlist;
+        zoomlist = mp->zoomnext;
+        mp->zoompending = 0;
+        
+        int targets = mousepad_targets(mp, 1);
+        
+        if(targets & EMIT_SEND)
+        {
+            t_canvas* canv = glist_getcanvas(mp->glist);
+            size_t hash = ((size_t)canv >> 4) * 31 + ((size_t)mp->sendname >> 4);
+            hash = (hash ^ (hash >> 15)) * 2654435761u;
+            i = (int)((hash ^ (hash >> 16)) & (size - 1));
+            
+            while(sent[i].sendname && ((sent[i].canv != canv) ||
+                (sent[i].sendname != mp->sendname))) i = (i + 1) & (size - 1);
+            
+            if(sent[i].sendname) targets &= ~EMIT_SEND;
+            else
+            {
+                sent[i].canv = canv;
+                sent[i].sendname = mp->sendname;
+            }
+        }
+        
+        if(!targets) continue;
+        
+        // push message to listeners as this can be considered an event
+        SETFLOAT(mp->out, (t_float)mp->zoomfactor);
+        mousepad_emit(mp, targets, symZoom, 1);
+    }
+    
+    freebytes(sent, size * sizeof(t_sent));
+}
+
+
+static void mousepad_zoom_unlist(t_mousepad *mp)
+{
+    t_mousepad** link = &zoomlist;
+    
+    if(!mp->zoompending) return;
+    
+    while(*link != mp) link = &(*link)->zoomnext;
+    *link = mp->zoomnext;
+    mp->zoompending = 0;
 }
 
 
@@ -505,15 +1618,15 @@ static void mousepad_zoom(t_mousepad *mp, t_floatarg zoomfactor)
     mp->pixw       = mp->width * (int)zoomfactor;
     mp->pixh       = mp->height * (int)zoomfactor;
     mp->zoomfactor = zoomfactor;
-    int sendable   = (mp->sendname != symEmpty);
+    mp->pixvalid   = 0;
     
-    // push message to listeners as this can be considered an event
-    SETFLOAT(mp->out, (zoomfactor));
-    outlet_anything(mp->obj.ob_outlet, symZoom, 1, mp->out);
-    if(sendable && mp->sendname->s_thing)
-        typedmess(mp->sendname->s_thing, symZoom, 1, mp->out);
-    if(mp->sendname_fixed->s_thing)
-        typedmess(mp->sendname_fixed->s_thing, symZoom, 1, mp->out);
+    if(!mp->zoompending)
+    {
+        if(!zoomlist) clock_delay(zoomclock, 0);
+        mp->zoomnext = zoomlist;
+        zoomlist = mp;
+        mp->zoompending = 1;
+    }
 }
 
 
@@ -526,7 +1639,6 @@ static void mousepad_zoom(t_mousepad *mp, t_floatarg zoomfactor)
 static void mousepad_get(t_mousepad *mp, t_symbol *selector)
 {
     int argc     = 0;
-    int sendable = (mp->sendname != symEmpty);
     
     if(selector == symSize)
     {
@@ -550,10 +1662,11 @@ static void mousepad_get(t_mousepad *mp, t_symbol *selector)
     
     else if(selector == symPos) // nominal object position on canvas
     {
-        int xpos = text_xpix(&mp->obj, mp->glist) / mp->zoomfactor;
-        int ypos = text_ypix(&mp->obj, mp->glist) / mp->zoomfactor;
-        SETFLOAT(mp->out,   (t_float)xpos);
-        SETFLOAT(mp->out+1, (t_float)ypos);
+        int xpos, ypos;
+        mp->pixvalid = 0;   // a hidden parent GOP may have moved since vis
+        mousepad_pixpos(mp, mp->glist, &xpos, &ypos);
+        SETFLOAT(mp->out,   (t_float)(xpos / mp->zoomfactor));
+        SETFLOAT(mp->out+1, (t_float)(ypos / mp->zoomfactor));
         argc = 2;
     }
     
@@ -563,26 +1676,17 @@ static void mousepad_get(t_mousepad *mp, t_symbol *selector)
         argc = 1;
     }
     
-    if(argc)
-    {
-        outlet_anything(mp->obj.ob_outlet, selector, argc, mp->out);
-        if(sendable && mp->sendname->s_thing)
-            typedmess(mp->sendname->s_thing, selector, argc, mp->out);
-        if(mp->sendname_fixed->s_thing)
-            typedmess(mp->sendname_fixed->s_thing, selector, argc, mp->out);
-    }
+    if(argc) mousepad_emit(mp, mousepad_targets(mp, 1), selector, argc);
 }
 
 
 static void mousepad_status(t_mousepad *mp)
 {
-    t_symbol* color = int2hexcolor(mp->intcolor);
-    
     post("mousepad width: %d", mp->width);
     post("mousepad height: %d", mp->height);
     post("mousepad send name: %s", mp->sendname_unexpanded->s_name);
     post("mousepad receive name: %s", mp->receivename_unexpanded->s_name);
-    post("mousepad color is %s", color->s_name);
+    post("mousepad color is #%06X", mp->intcolor);   // no symbol needed
     post("object ID is %s", mp->objID->s_name);
 }
 
@@ -593,90 +1697,454 @@ static void mousepad_delta(t_mousepad *mp, t_floatarg dx, t_floatarg dy)
     const int isnew  = 0;
     mp->obj.te_xpix += (int)dx * mp->zoomfactor;
     mp->obj.te_ypix += (int)dy * mp->zoomfactor;
+    mp->pixvalid = 0;
+    mp->glides &= ~(1 << GLIDE_POS);
 
     mousepad_draw(mp, isnew, 0);
+    mousepad_repl_mark(mp, REPL_POS);
 }
 
 
-static void mousepad_pos(t_mousepad *mp, t_floatarg xpos, t_floatarg ypos)
+static void mousepad_pos(t_mousepad *mp, t_floatarg xpos, t_floatarg ypos)
+{
+    const int isnew = 0;
+    mp->obj.te_xpix = (int)xpos * mp->zoomfactor;
+    mp->obj.te_ypix = (int)ypos * mp->zoomfactor;
+    mp->pixvalid = 0;
+    mp->glides &= ~(1 << GLIDE_POS);
+    
+    mousepad_draw(mp, isnew, 0);
+    mousepad_repl_mark(mp, REPL_POS);
+}
+
+
+// Color changes are drawn right away, unless a gradient is collecting them in
+// a batch. See mousepad_gradient().
+static t_drawbatch* colorbatch;
+
+
+static void mousepad_storecolor(t_mousepad *mp, int intcolor)
+{
+    mp->glides &= ~(1 << GLIDE_COLOR);  // explicit setting ends glide
+    mp->intcolor = intcolor;
+    mousepad_repl_mark(mp, REPL_COLOR);
+}
+
+
+static void mousepad_drawcolor(t_mousepad *mp)
+{
+    if(!glist_isvisible(mp->glist)) return;
+    
+    t_canvas* canv = glist_getcanvas(mp->glist);
+    if(colorbatch)
+        drawbatch_fillcolor(colorbatch, canv, (t_int)mp, BASE, mp->intcolor);
+    else draw_fillcolor(canv, (t_int)mp, BASE, mp->intcolor);
+}
+
+
+static void mousepad_setcolor(t_mousepad *mp, int intcolor)
+{
+    mousepad_storecolor(mp, intcolor);
+    mousepad_drawcolor(mp);
+}
+
+
+static void mousepad_color(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
+{
+    if(!argc) return;
+    
+    mousepad_setcolor(mp, atom2color(argc, argv));
+}
+
+
+// Hue in degrees, other components 0 till 1.
+static void mousepad_hsv(t_mousepad *mp, t_floatarg h, t_floatarg s,
+                            t_floatarg v)
+{
+    mousepad_setcolor(mp, hsv2color(h, s, v));
+}
+
+
+static void mousepad_hsl(t_mousepad *mp, t_floatarg h, t_floatarg s,
+                            t_floatarg l)
+{
+    mousepad_setcolor(mp, hsl2color(h, s, l));
+}
+
+
+// [palette <name> <color> <color> ...( defines a palette for all instances.
+// Colors are floats or webcolor symbols.
+static void mousepad_palette(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
+{
+    if((argc < 2) || !IS_A_SYMBOL(argv, 0) || 
+        (atom_getsymbolarg(0, argc, argv)->s_name[0] == '#'))
+    {
+        pd_error(mp, "mousepad: palette: expected name and colors");
+        return;
+    }
+    
+    palette_define(atom_getsymbolarg(0, argc, argv), argc - 1, argv + 1);
+}
+
+
+// [gradient <color> <color> <name> <name> ...( or [gradient <palette> <name>
+// <name> ...( colors the mousepads with given receive names in order, from
+// the first to the last color. Each name is sent a 'color' message, so that
+// all mousepads sharing a receive name get the same color (and other receivers
+// of the name see the message too). All objects are redrawn in one batch.
+static void mousepad_gradient(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
+{
+    t_palette twocolors, *palette;
+    t_drawbatch batch = {0, 0, 0};
+    t_drawbatch* outerbatch = colorbatch;   // a receiver may start a gradient
+    t_atom color;
+    int colors[2], i;
+    
+    if(argc < 2) return;
+    
+    palette = palette_find(atom_getsymbolarg(0, argc, argv));
+    if(palette)
+    {
+        argc -= 1;
+        argv += 1;
+    }
+    else if(argc >= 3)
+    {
+        colors[0] = atom2color(1, argv);
+        colors[1] = atom2color(1, argv + 1);
+        twocolors.size   = 2;
+        twocolors.colors = colors;
+        palette = &twocolors;
+        argc -= 2;
+        argv += 2;
+    }
+    else
+    {
+        pd_error(mp, "mousepad: gradient: expected palette or two colors, "
+            "then receive names");
+        return;
+    }
+    
+    colorbatch = &batch;
+    
+    for(i = 0; i < argc; i++)
+    {
+        t_symbol* name = atom_getsymbolarg(i, argc, argv);
+        if(!name->s_thing) continue;
+        
+        SETFLOAT(&color, (t_float)palette_color(palette, (argc > 1) ?
+            (double)i / (argc - 1) : 0));
+        typedmess(name->s_thing, symColor, 1, &color);
+    }
+    
+    colorbatch = outerbatch;
+    drawbatch_send(&batch);
+}
+
+
+// Nominal width and height. If only one argument is given, then height = width.
+static void mousepad_size(t_mousepad *mp, int argc, t_atom *argv)
+{
+    int width = DEFSIZE, height = DEFSIZE;
+    
+    if(argc >= 1)
+    {
+        if(IS_A_FLOAT(argv, 0))       width = (int)argv[0].a_w.w_float;
+        if(argc == 1) height = width;
+        else if(IS_A_FLOAT(argv, 1)) height = (int)argv[1].a_w.w_float;
+    }
+    
+    if(width < 1) width = 1;
+    if(height < 1) height = 1;
+    
+    mp->width = width;
+    mp->height = height;
+    
+    // width and height expressed in screen pixels
+    mp->pixw = width  * mp->zoomfactor;
+    mp->pixh = height * mp->zoomfactor;
+}
+
+
+static void mousepad_resize(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
+{
+    const int isnew = 0;
+    
+    mousepad_size(mp, argc, argv);
+    mp->glides &= ~(1 << GLIDE_SIZE);
+    mousepad_draw(mp, isnew, 0);
+    mousepad_repl_mark(mp, REPL_SIZE);
+}
+
+
+// Set dirty flag in top level parent. We only want to set the dirty flag if
+// a setting is changed through the properties dialog (and not through a direct
+// user call). Therefore the properties dialog must call this function.
+static void mousepad_dirty(t_mousepad* mp)
+{
+    canvas_dirty(mp->glist, 1);
+}
+
+
+// Output filters:
+// [filter events <type> ...( outputs only the given event types: button, drag,
+//     deltas and hover. Without types all events are output.
+// [filter mods <shift> <alt>( outputs events only while the modifier keys with
+//     argument 1 are held. For drags, the keys at button down count, and a
+//     button up is output whenever its button down was. Remote events from
+//     [mousepad-mirror] carry no modifier keys and are not filtered by them.
+// [filter deadzone <n>( outputs drag, deltas and hover only after a movement
+//     of at least n (nominal) pixels in x or y since the last position output.
+//     The drag at button down is always output.
+// [filter change <0/1>( outputs drag, deltas and hover only if the nominal
+//     position differs from the last position output, skipping sub-pixel
+//     jitter. The drag at button down is always output.
+// [filter reset( outputs all events again.
+
+static void mousepad_filter(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
+{
+    t_symbol* setting = atom_getsymbolarg(0, argc, argv);
+    int i;
+    
+    if(setting == gensym("events"))
+    {
+        if(argc < 2) mp->filterevents = FILTER_EVENTS;
+        else mp->filterevents = 0;
+        
+        for(i = 1; i < argc; i++)
+        {
+            t_symbol* type = atom_getsymbolarg(i, argc, argv);
+            if(type == symButton)      mp->filterevents |= FILTER_BUTTON;
+            else if(type == symDrag)   mp->filterevents |= FILTER_DRAG;
+            else if(type == symDeltas) mp->filterevents |= FILTER_DELTAS;
+            else if(type == symHover)  mp->filterevents |= FILTER_HOVER;
+            else pd_error(mp, "mousepad: filter events: unknown type %s",
+                type->s_name);
+        }
+    }
+    
+    else if(setting == gensym("mods"))
+    {
+        mp->filtermods = 0;
+        if(atom_getfloatarg(1, argc, argv) != 0) mp->filtermods |= FILTER_SHIFT;
+        if(atom_getfloatarg(2, argc, argv) != 0) mp->filtermods |= FILTER_ALT;
+    }
+    
+    else if(setting == gensym("deadzone"))
+    {
+        mp->filterdeadzone = (int)atom_getfloatarg(1, argc, argv);
+        if(mp->filterdeadzone < 0) mp->filterdeadzone = 0;
+    }
+    
+    else if(setting == gensym("change"))
+        mp->filterchange = (atom_getfloatarg(1, argc, argv) != 0);
+    
+    else if(setting == gensym("reset"))
+    {
+        mp->filterevents   = FILTER_EVENTS;
+        mp->filtermods     = 0;
+        mp->filterdeadzone = 0;
+        mp->filterchange   = 0;
+    }
+    
+    else pd_error(mp, "mousepad: filter: expected events, mods, deadzone, "
+        "change or reset");
+}
+
+
+// [cursor 1( shows a crosshair at the last mouse position, [cursor 0( hides it.
+// [trail <n>( shows the last n mouse positions as a fading line, n = 0 hides.
+// Changes of the trail length start a new trail. Trail colors are derived from
+// the fill color at that moment.
+
+static void mousepad_cursor(t_mousepad *mp, t_floatarg on)
 {
-    const int isnew = 0;
-    mp->obj.te_xpix = (int)xpos * mp->zoomfactor;
-    mp->obj.te_ypix = (int)ypos * mp->zoomfactor;
+    int visible = glist_isvisible(mp->glist);
     
-    mousepad_draw(mp, isnew, 0);
+    if(visible) mousepad_indicator_erase(mp, CURSOR);
+    mp->cursor = (on != 0);
+    if(visible) mousepad_indicator_create(mp, CURSOR);
 }
 
 
-static void mousepad_color(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
+static void mousepad_trail(t_mousepad *mp, t_floatarg length)
 {
-    if(!argc) return;
-    
-    int intcolor = DEFCOLOR;
+    int visible = glist_isvisible(mp->glist);
     
-    if(IS_A_FLOAT(argv, 0)) 
-    {
-        intcolor = (int)atom_getfloatarg(0, 1, argv);
-        intcolor &= 0xFFFFFF;
-    }
+    if(length < 0) length = 0;
+    if(length > TRAILMAX) length = TRAILMAX;
     
-    else if(IS_A_SYMBOL(argv, 0))
-    {
-        t_symbol* hexcolor;
-        hexcolor = atom_getsymbolarg(0, 1, argv);
-        if(hexcolor->s_name[0] == '#')
-            intcolor = hexcolor2int(hexcolor->s_name);
-    }
+    if(visible) mousepad_indicator_erase(mp, TRAIL);
+    mp->traillength = (int)length;
+    mp->trailcount  = 0;
+    if(visible) mousepad_indicator_create(mp, TRAIL);
+}
 
-    if(glist_isvisible(mp->glist))
-    {
-        t_canvas* canv = glist_getcanvas(mp->glist);
-        draw_fillcolor(canv, (t_int)mp, BASE, intcolor);
-    }
 
-    mp->intcolor = intcolor;
-}
+// --------- glide animations --------------------------------------------------
 
+// [glide pos <x> <y> <ms>(, [glide size <w> <h> <ms>( and [glide color <c> <ms>(
+// move, resize or recolor the object over the given time. Color argument is
+// float or webcolor symbol like for method 'color'. [glide stop( ends all
+// glides where they are. A direct setting of pos, size or color ends the glide
+// of that kind. Glides of all objects are stepped together at GLIDE_FPS.
 
-// Nominal width and height. If only one argument is given, then height = width.
-static void mousepad_size(t_mousepad *mp, int argc, t_atom *argv)
+
+static void mousepad_glide_tick(void *dummy)
 {
-    int width = DEFSIZE, height = DEFSIZE;
+    t_mousepad** link = &glidelist;
+    t_mousepad* mp;
     
-    if(argc >= 1)
+    while((mp = *link))
     {
-        if(IS_A_FLOAT(argv, 0))       width = (int)argv[0].a_w.w_float;
-        if(argc == 1) height = width;
-        else if(IS_A_FLOAT(argv, 1)) height = (int)argv[1].a_w.w_float;
+        int redraw = 0, k, i;
+        
+        for(k = 0; k < GLIDE_KINDS; k++)
+        {
+            if(!(mp->glides & (1 << k))) continue;
+            
+            t_glide* glide = &mp->glide[k];
+            double phase = clock_gettimesince(glide->starttime) / glide->duration;
+            int value[3];
+            
+            if(phase >= 1.)
+            {
+                phase = 1.;
+                mp->glides &= ~(1 << k);
+            }
+            
+            for(i = 0; i < 3; i++)
+                value[i] = glide->from[i]
+                    + (int)floor((glide->to[i] - glide->from[i]) * phase + 0.5);
+            
+            if(k == GLIDE_POS)
+            {
+                mp->obj.te_xpix = value[0] * mp->zoomfactor;
+                mp->obj.te_ypix = value[1] * mp->zoomfactor;
+                mp->pixvalid    = 0;
+                mousepad_repl_mark(mp, REPL_POS);
+            }
+            
+            else if(k == GLIDE_SIZE)
+            {
+                mp->width  = value[0];
+                mp->height = value[1];
+                mp->pixw   = value[0] * mp->zoomfactor;
+                mp->pixh   = value[1] * mp->zoomfactor;
+                mousepad_repl_mark(mp, REPL_SIZE);
+            }
+            
+            else
+            {
+                mp->intcolor = (value[0] << 16) | (value[1] << 8) | value[2];
+                mousepad_repl_mark(mp, REPL_COLOR);
+            }
+            
+            redraw |= (1 << k);
+        }
+        
+        // one redraw per object per frame
+        if(redraw & ((1 << GLIDE_POS) | (1 << GLIDE_SIZE)))
+            mousepad_draw(mp, 0, 0);
+        if(redraw & (1 << GLIDE_COLOR)) mousepad_drawcolor(mp);
+        
+        // unlink objects without active glides
+        if(!mp->glides)
+        {
+            *link = mp->glidenext;
+            mp->glidelisted = 0;
+        }
+        else link = &mp->glidenext;
     }
     
-    if(width < 1) width = 1;
-    if(height < 1) height = 1;
+    if(glidelist) clock_delay(glideclock, 1000. / GLIDE_FPS);
+}
+
+
+static void mousepad_glide_start(t_mousepad *mp, int kind, int from[],
+                                    int to[], t_floatarg ms)
+{
+    t_glide* glide = &mp->glide[kind];
     
-    mp->width = width;
-    mp->height = height;
+    memcpy(glide->from, from, sizeof(glide->from));
+    memcpy(glide->to, to, sizeof(glide->to));
+    glide->starttime = clock_getlogicaltime();
+    glide->duration  = (ms > 0) ? ms : 1e-9;    // zero time jumps at next frame
+    mp->glides |= (1 << kind);
     
-    // width and height expressed in screen pixels
-    mp->pixw = width  * mp->zoomfactor;
-    mp->pixh = height * mp->zoomfactor;
+    if(!mp->glidelisted)
+    {
+        if(!glidelist) clock_delay(glideclock, 1000. / GLIDE_FPS);
+        mp->glidenext = glidelist;
+        glidelist = mp;
+        mp->glidelisted = 1;
+    }
 }
 
 
-static void mousepad_resize(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
+static void mousepad_glide_unlist(t_mousepad *mp)
 {
-    const int isnew = 0;
+    t_mousepad** link = &glidelist;
     
-    mousepad_size(mp, argc, argv);
-    mousepad_draw(mp, isnew, 0);
+    if(!mp->glidelisted) return;
+    
+    while(*link != mp) link = &(*link)->glidenext;
+    *link = mp->glidenext;
+    mp->glidelisted = 0;
+    mp->glides = 0;
+    
+    if(!glidelist) clock_unset(glideclock);
 }
 
 
-// Set dirty flag in top level parent. We only want to set the dirty flag if
-// a setting is changed through the properties dialog (and not through a direct
-// user call). Therefore the properties dialog must call this function.
-static void mousepad_dirty(t_mousepad* mp)
+static void mousepad_glide(t_mousepad *mp, t_symbol *s, int argc, t_atom *argv)
 {
-    canvas_dirty(mp->glist, 1);
+    t_symbol* kind = atom_getsymbolarg(0, argc, argv);
+    int from[3] = {0, 0, 0}, to[3] = {0, 0, 0};
+    
+    if(kind == gensym("stop"))
+    {
+        mp->glides = 0;     // unlinked at next frame
+        return;
+    }
+    
+    if((kind == symPos) && (argc >= 4))
+    {
+        from[0] = mp->obj.te_xpix / mp->zoomfactor;
+        from[1] = mp->obj.te_ypix / mp->zoomfactor;
+        to[0]   = (int)atom_getfloatarg(1, argc, argv);
+        to[1]   = (int)atom_getfloatarg(2, argc, argv);
+        mousepad_glide_start(mp, GLIDE_POS, from, to,
+            atom_getfloatarg(3, argc, argv));
+    }
+    
+    else if((kind == symSize) && (argc >= 4))
+    {
+        from[0] = mp->width;
+        from[1] = mp->height;
+        to[0]   = (int)atom_getfloatarg(1, argc, argv);
+        to[1]   = (int)atom_getfloatarg(2, argc, argv);
+        if(to[0] < 1) to[0] = 1;
+        if(to[1] < 1) to[1] = 1;
+        mousepad_glide_start(mp, GLIDE_SIZE, from, to,
+            atom_getfloatarg(3, argc, argv));
+    }
+    
+    else if((kind == symColor) && (argc >= 3))
+    {
+        int intcolor = atom2color(1, argv + 1);
+        from[0] = (mp->intcolor >> 16) & 0xFF;
+        from[1] = (mp->intcolor >> 8) & 0xFF;
+        from[2] = mp->intcolor & 0xFF;
+        to[0]   = (intcolor >> 16) & 0xFF;
+        to[1]   = (intcolor >> 8) & 0xFF;
+        to[2]   = intcolor & 0xFF;
+        mousepad_glide_start(mp, GLIDE_COLOR, from, to,
+            atom_getfloatarg(2, argc, argv));
+    }
+    
+    else pd_error(mp, "mousepad: glide: expected pos x y ms, size w h ms, "
+        "color c ms or stop");
 }
 
 
@@ -698,6 +2166,7 @@ static void mousepad_send(t_mousepad *mp, t_symbol *sendname)
     
     mp->sendname_unexpanded = sendname;
     mp->sendname = canvas_realizedollar(glist, sendname); // g_canvas.c
+    mp->sendable = is_sendable;
     
     int change = was_sendable - is_sendable;
     if(change) mousepad_change_io(mp, change, INLET);     // draw or erase inlet
@@ -721,12 +2190,112 @@ static void mousepad_receive(t_mousepad *mp, t_symbol *receivename)
     if(receivename != symEmpty) is_receivable = 1;
     if(is_receivable) pd_bind(object, receivename);
     mp->receivename = receivename;
+    receivegeneration++;
     
     int change = was_receivable - is_receivable;
     if(change) mousepad_change_io(mp, change, OUTLET);   // draw or erase outlet
 }
 
 
+// --------- replication -------------------------------------------------------
+
+// [replicate <port> <channel>( starts streaming state to UDP port <port> on
+// localhost, where a [mousepad-mirror <port>] applies it to the object(s) with
+// receive name <channel>. Channel defaults to the own receive name. The first
+// record has all fields, and so has a refresh record every REPL_REFRESH
+// milliseconds. All objects replicate over one shared socket, and records of
+// objects with the same port share packets. [replicate 0( stops replication.
+
+
+static void mousepad_replicate(t_mousepad *mp, t_floatarg port, t_symbol *channel)
+{
+    mousepad_repl_stop(mp);
+    
+    if(port <= 0) return;
+    
+    if(port > 65535)
+    {
+        pd_error(mp, "mousepad: replicate: port %d out of range", (int)port);
+        return;
+    }
+    
+    if(channel == &s_) channel = mp->receivename;
+    if(channel == symEmpty)
+    {
+        pd_error(mp, "mousepad: replicate: no channel name and no receive name");
+        return;
+    }
+    
+    // one socket for all objects, opened by the first one
+    if(replfd < 0) replfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(replfd < 0)
+    {
+        pd_error(mp, "mousepad: replicate: could not open socket");
+        return;
+    }
+    
+    memset(&mp->repladdr, 0, sizeof(mp->repladdr));
+    mp->repladdr.sin_family      = AF_INET;
+    mp->repladdr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    mp->repladdr.sin_port        = htons((unsigned short)port);
+    
+    mp->replchannel = channel;
+    mousepad_repl_start(mp);
+}
+
+
+// --------- shared memory export ----------------------------------------------
+
+// [export <name>( publishes pointer state in POSIX shared memory object
+// "/<name>" for readers in other processes. [export( without name stops it
+// and removes the object. Not available on Windows.
+
+
+static void mousepad_export(t_mousepad *mp, t_symbol *name)
+{
+    mousepad_shm_close(mp);
+    
+    if(name == &s_) return;
+    
+#ifdef MSW
+    pd_error(mp, "mousepad: export: shared memory not supported on Windows");
+#else
+    char shmname[MAXPDSTRING];
+    
+    if(name->s_name[0] == '/') snprintf(shmname, MAXPDSTRING, "%s", name->s_name);
+    else snprintf(shmname, MAXPDSTRING, "/%s", name->s_name);
+    
+    int fd = shm_open(shmname, O_CREAT | O_RDWR, 0644);
+    if(fd < 0)
+    {
+        pd_error(mp, "mousepad: export: could not open shared memory %s", shmname);
+        return;
+    }
+    
+    void* block = MAP_FAILED;
+    if(!ftruncate(fd, sizeof(t_mousepad_shm)))
+        block = mmap(NULL, sizeof(t_mousepad_shm), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+    close(fd);  // mapping stays valid
+    
+    if(block == MAP_FAILED)
+    {
+        pd_error(mp, "mousepad: export: could not map shared memory %s", shmname);
+        shm_unlink(shmname);
+        return;
+    }
+    
+    mp->shm     = (t_mousepad_shm*)block;
+    mp->shmname = gensym(shmname);
+    memset(&mp->shmstate, 0, sizeof(t_mousepad_state));
+    
+    mp->shm->magic   = MOUSEPAD_SHM_MAGIC;
+    mp->shm->version = MOUSEPAD_SHM_VERSION;
+    mousepad_shm_publish(mp);
+#endif
+}
+
+
 // -------- creation, init, deletion, setup ------------------------------------
 
 // Try to fetch unexpanded send- and receive names from binbuf. Binbuf is
@@ -789,11 +2358,40 @@ static void *mousepad_new(t_symbol *s, int argc, t_atom *argv)
 
     mp->intcolor     = DEFCOLOR;
     mp->zoomfactor   = DEFZOOM;
+    mp->pixvalid     = 0;
+    mp->zoompending  = 0;
     mp->xval         = 0;
     mp->yval         = 0;
+    mp->deltax       = 0;
+    mp->deltay       = 0;
+    mp->filterevents = FILTER_EVENTS;
+    mp->filtermods   = 0;
+    mp->filterdeadzone = 0;
+    mp->filterchange = 0;
+    mp->modspass     = 1;
+    mp->pressed      = 0;
+    mp->lastx        = 0;
+    mp->lasty        = 0;
+    mp->pendingx     = 0;
+    mp->pendingy     = 0;
     mp->buttonstate  = 0;
     mp->sendname     = symEmpty;
+    mp->sendable     = 0;
     mp->receivename  = symEmpty;
+    mp->cursor       = 0;
+    mp->traillength  = 0;
+    mp->trailhead    = 0;
+    mp->trailcount   = 0;
+    mp->glides       = 0;
+    mp->glidelisted  = 0;
+    mp->replicating  = 0;
+    mp->replnext     = 0;
+    mp->repldirty    = 0;
+    mp->replfull     = 0;
+    mp->replchannel  = symEmpty;
+    memset(mp->replsent, 0, sizeof(mp->replsent));
+    mp->shm          = 0;
+    mp->shmname      = symEmpty;
     
     // process instantiation arguments
     mousepad_size(mp, argc, argv); // argument index 0 and 1
@@ -820,6 +2418,13 @@ static void mousepad_free(t_mousepad *mp)
 {
     pd_unbind(&mp->obj.ob_pd, mp->receivename_fixed);
     if(mp->receivename != symEmpty) pd_unbind(&mp->obj.ob_pd, mp->receivename);
+    receivegeneration++;
+    mousepad_repl_stop(mp);
+    mousepad_shm_close(mp);
+    mousepad_glide_unlist(mp);
+    mousepad_zoom_unlist(mp);
+    sys_unqueuegui(mp);
+    clock_free(mp->initclock);
 }
 
 
@@ -872,6 +2477,342 @@ static void mousepad_properties(t_gobj *z, t_glist *owner)
 }
 
 
+// ---------- mousepad-state ---------------------------------------------------
+
+// Readers that poll pointer state of the mousepad with given receive name,
+// straight from its struct. A mousepad does not know about its readers and
+// sends them nothing, so readers cost nothing between polls. The mousepad is
+// looked up on 'set' and 'dsp', and again only when any mousepad receive name
+// was bound or unbound since. The receive name should be unique: with
+// several mousepads, one of them is read and Pd warns at each lookup.
+// 
+// [mousepad-state <name>]: on bang, output list: x y button deltax deltay
+// [mousepad-state~ <name>]: signal outlets x, y and button, updated per block
+// 
+// Both accept [set <name>( to attach to another mousepad.
+
+
+static t_class *mousepad_state_class;
+static t_class *mousepad_state_tilde_class;
+
+
+typedef struct
+{
+    t_object  obj;
+    t_symbol* padname;                // receive name of mousepad to poll
+    t_mousepad* pad;                  // mousepad found, or null
+    unsigned int generation;          // receivegeneration at lookup
+    t_sample* outvec[3];              // signal outlets (tilde class only)
+    int       blocksize;
+} t_mousepad_state_reader;
+
+
+static void mousepad_state_lookup(t_mousepad_state_reader *reader, int report)
+{
+    reader->generation = receivegeneration;
+    
+    if(reader->padname == symEmpty) reader->pad = 0;
+    else reader->pad =
+        (t_mousepad*)pd_findbyclass(reader->padname, mousepad_class);
+    
+    if(report && !reader->pad && reader->padname != symEmpty)
+        pd_error(reader, "%s: no mousepad named %s",
+            class_getname(reader->obj.ob_pd),
+            reader->padname->s_name);
+}
+
+
+// Cheap enough to call per block: the lookup is only repeated, silently, when
+// receive names have changed. A freed mousepad has unbound its name, so the
+// pointer is never used after free.
+static t_mousepad* mousepad_state_find(t_mousepad_state_reader *reader)
+{
+    if(reader->generation != receivegeneration)
+        mousepad_state_lookup(reader, 0);
+    
+    return reader->pad;
+}
+
+
+static void mousepad_state_bang(t_mousepad_state_reader *reader)
+{
+    t_mousepad* mp = mousepad_state_find(reader);
+    t_atom out[5];
+    
+    if(!mp)
+    {
+        pd_error(reader, "mousepad-state: no mousepad named %s",
+            reader->padname->s_name);
+        return;
+    }
+    
+    SETFLOAT(out,   (t_float)(mp->xval / mp->zoomfactor));
+    SETFLOAT(out+1, (t_float)(mp->yval / mp->zoomfactor));
+    SETFLOAT(out+2, (t_float)mp->buttonstate);
+    SETFLOAT(out+3, (t_float)(mp->deltax / mp->zoomfactor));
+    SETFLOAT(out+4, (t_float)(mp->deltay / mp->zoomfactor));
+    outlet_list(reader->obj.ob_outlet, &s_list, 5, out);
+}
+
+
+static void mousepad_state_set(t_mousepad_state_reader *reader, t_symbol *name)
+{
+    if(name == &s_) name = symEmpty;
+    reader->padname = name;
+    mousepad_state_lookup(reader, 1);
+}
+
+
+static void *mousepad_state_new(t_symbol *name)
+{
+    t_mousepad_state_reader *reader =
+        (t_mousepad_state_reader *)pd_new(mousepad_state_class);
+    
+    if(name == &s_) name = symEmpty;
+    reader->padname = name;
+    mousepad_state_lookup(reader, 0);   // mousepad may follow in the patch
+    outlet_new(&reader->obj, &s_list);
+    
+    return (reader);
+}
+
+
+// If no mousepad is found, output zeros. This was reported by the dsp method.
+static t_int *mousepad_state_tilde_perform(t_int *w)
+{
+    t_mousepad_state_reader *reader = (t_mousepad_state_reader *)(w[1]);
+    t_mousepad* mp = mousepad_state_find(reader);
+    t_sample value[3] = {0, 0, 0};
+    int i, j, n = reader->blocksize;
+    
+    if(mp)
+    {
+        value[0] = (t_sample)(mp->xval / mp->zoomfactor);
+        value[1] = (t_sample)(mp->yval / mp->zoomfactor);
+        value[2] = (t_sample)mp->buttonstate;
+    }
+    
+    for(i = 0; i < 3; i++)
+    {
+        t_sample* out = reader->outvec[i];
+        for(j = 0; j < n; j++) out[j] = value[i];
+    }
+    
+    return (w + 2);
+}
+
+
+static void mousepad_state_tilde_dsp(t_mousepad_state_reader *reader,
+                                        t_signal **sp)
+{
+    reader->outvec[0] = sp[0]->s_vec;
+    reader->outvec[1] = sp[1]->s_vec;
+    reader->outvec[2] = sp[2]->s_vec;
+    reader->blocksize = sp[0]->s_n;
+    mousepad_state_lookup(reader, 1);
+    dsp_add(mousepad_state_tilde_perform, 1, reader);
+}
+
+
+static void *mousepad_state_tilde_new(t_symbol *name)
+{
+    t_mousepad_state_reader *reader =
+        (t_mousepad_state_reader *)pd_new(mousepad_state_tilde_class);
+    
+    if(name == &s_) name = symEmpty;
+    reader->padname = name;
+    mousepad_state_lookup(reader, 0);   // mousepad may follow in the patch
+    outlet_new(&reader->obj, &s_signal);
+    outlet_new(&reader->obj, &s_signal);
+    outlet_new(&reader->obj, &s_signal);
+    
+    return (reader);
+}
+
+
+static void mousepad_state_setup(void)
+{
+    mousepad_state_class = class_new(gensym("mousepad-state"),
+        (t_newmethod)mousepad_state_new, 0,
+        sizeof(t_mousepad_state_reader), 0, A_DEFSYM, 0);
+    class_addbang(mousepad_state_class, (t_method)mousepad_state_bang);
+    class_addmethod(mousepad_state_class, (t_method)mousepad_state_set,
+        gensym("set"), A_DEFSYM, 0);
+    
+    mousepad_state_tilde_class = class_new(gensym("mousepad-state~"),
+        (t_newmethod)mousepad_state_tilde_new, 0,
+        sizeof(t_mousepad_state_reader), 0, A_DEFSYM, 0);
+    class_addmethod(mousepad_state_tilde_class,
+        (t_method)mousepad_state_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(mousepad_state_tilde_class, (t_method)mousepad_state_set,
+        gensym("set"), A_DEFSYM, 0);
+}
+
+
+// ---------- mousepad-mirror --------------------------------------------------
+
+// Receiver for replication packets sent by mousepads in another Pd process.
+// Records are applied in order. Each field is forwarded as a message to the channel name: 'size', 'pos' and
+// 'color' settings, and 'button' and 'pointer' remote mouse events. Typically
+// the channel is the receive name of a mousepad, but any receiver will do.
+
+
+static t_class *mousepad_mirror_class;
+
+
+typedef struct
+{
+    t_object  obj;
+    int       fd;                     // UDP socket bound to localhost, or -1
+} t_mousepad_mirror;
+
+
+// Apply one record at index n. Returns the index of the next record, or -1 if
+// the record is truncated.
+static int mousepad_mirror_record(const unsigned char packet[], int size, int n)
+{
+    char channel[256];
+    t_atom out[2];
+    int mask, namelen, i, field[2];
+    
+    if(size < n + 2) return (-1);
+    
+    mask    = packet[n];
+    namelen = packet[n+1];
+    n      += 2;
+    int name = n;
+    n      += namelen;
+    
+    // verify packet length against the fields announced in mask
+    int expected = n;
+    if(mask & REPL_XY)     expected += 8;
+    if(mask & REPL_BUTTON) expected += 4;
+    if(mask & REPL_POS)    expected += 8;
+    if(mask & REPL_SIZE)   expected += 8;
+    if(mask & REPL_COLOR)  expected += 4;
+    if(size < expected) return (-1);
+    
+    memcpy(channel, packet + name, namelen);
+    channel[namelen] = 0;
+    t_symbol* target = gensym(channel);
+    
+    // apply settings before events, buttons before pointer moves
+    int xy[2], button = 0;
+    if(mask & REPL_XY)
+    {
+        n = packet_getint(packet, n, &xy[0]);
+        n = packet_getint(packet, n, &xy[1]);
+    }
+    if(mask & REPL_BUTTON) n = packet_getint(packet, n, &button);
+    
+    if(mask & REPL_POS)
+    {
+        for(i = 0; i < 2; i++) n = packet_getint(packet, n, &field[i]);
+        SETFLOAT(out, field[0]);
+        SETFLOAT(out+1, field[1]);
+        if(target->s_thing) typedmess(target->s_thing, symPos, 2, out);
+    }
+    
+    if(mask & REPL_SIZE)
+    {
+        for(i = 0; i < 2; i++) n = packet_getint(packet, n, &field[i]);
+        SETFLOAT(out, field[0]);
+        SETFLOAT(out+1, field[1]);
+        if(target->s_thing) typedmess(target->s_thing, symSize, 2, out);
+    }
+    
+    if(mask & REPL_COLOR)
+    {
+        n = packet_getint(packet, n, &field[0]);
+        SETFLOAT(out, field[0]);
+        if(target->s_thing) typedmess(target->s_thing, symColor, 1, out);
+    }
+    
+    if((mask & REPL_BUTTON) && target->s_thing)
+    {
+        SETFLOAT(out, button);
+        typedmess(target->s_thing, symButton, 1, out);
+    }
+    
+    if((mask & REPL_XY) && target->s_thing)
+    {
+        SETFLOAT(out, xy[0]);
+        SETFLOAT(out+1, xy[1]);
+        typedmess(target->s_thing, symPointer, 2, out);
+    }
+    
+    return (n);
+}
+
+
+static void mousepad_mirror_read(t_mousepad_mirror *mm, int fd)
+{
+    unsigned char packet[REPL_MAXPACKET];
+    int size = recv(fd, (char*)packet, REPL_MAXPACKET, 0);
+    int n = 4;
+    
+    if(size < 4 || memcmp(packet, REPL_MAGIC, 4)) return;
+    
+    while((n >= 0) && (n < size)) n = mousepad_mirror_record(packet, size, n);
+}
+
+
+static void *mousepad_mirror_new(t_floatarg port)
+{
+    t_mousepad_mirror *mm = (t_mousepad_mirror *)pd_new(mousepad_mirror_class);
+    struct sockaddr_in addr;
+    
+    mm->fd = -1;
+    
+    if(port <= 0 || port > 65535)
+    {
+        pd_error(mm, "mousepad-mirror: port %d out of range", (int)port);
+        return (mm);
+    }
+    
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0)
+    {
+        pd_error(mm, "mousepad-mirror: could not open socket");
+        return (mm);
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons((unsigned short)port);
+    
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        pd_error(mm, "mousepad-mirror: could not bind to port %d", (int)port);
+        socket_close(fd);
+        return (mm);
+    }
+    
+    mm->fd = fd;
+    sys_addpollfn(fd, (t_fdpollfn)mousepad_mirror_read, mm);
+    
+    return (mm);
+}
+
+
+static void mousepad_mirror_free(t_mousepad_mirror *mm)
+{
+    if(mm->fd < 0) return;
+    
+    sys_rmpollfn(mm->fd);
+    socket_close(mm->fd);
+}
+
+
+static void mousepad_mirror_setup(void)
+{
+    mousepad_mirror_class = class_new(gensym("mousepad-mirror"),
+        (t_newmethod)mousepad_mirror_new, (t_method)mousepad_mirror_free,
+        sizeof(t_mousepad_mirror), CLASS_NOINLET, A_DEFFLOAT, 0);
+}
+
+
 void mousepad_setup(void)
 {
     mousepad_class = class_new(gensym("mousepad"), (t_newmethod)mousepad_new,
@@ -882,6 +2823,14 @@ void mousepad_setup(void)
         gensym("size"), A_GIMME, 0);
     class_addmethod(mousepad_class, (t_method)mousepad_color,
         gensym("color"), A_GIMME, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_hsv,
+        gensym("hsv"), A_FLOAT, A_FLOAT, A_FLOAT, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_hsl,
+        gensym("hsl"), A_FLOAT, A_FLOAT, A_FLOAT, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_palette,
+        gensym("palette"), A_GIMME, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_gradient,
+        gensym("gradient"), A_GIMME, 0);
     class_addmethod(mousepad_class, (t_method)mousepad_delta,
         gensym("delta"), A_FLOAT, A_FLOAT, 0);
     class_addmethod(mousepad_class, (t_method)mousepad_pos,
@@ -898,6 +2847,22 @@ void mousepad_setup(void)
         gensym("dirty"), 0);
     class_addmethod(mousepad_class, (t_method)mousepad_zoom,
         gensym("zoom"), A_CANT, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_filter,
+        gensym("filter"), A_GIMME, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_cursor,
+        gensym("cursor"), A_FLOAT, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_trail,
+        gensym("trail"), A_FLOAT, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_glide,
+        gensym("glide"), A_GIMME, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_replicate,
+        gensym("replicate"), A_DEFFLOAT, A_DEFSYM, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_export,
+        gensym("export"), A_DEFSYM, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_button,
+        gensym("button"), A_FLOAT, 0);
+    class_addmethod(mousepad_class, (t_method)mousepad_pointer,
+        gensym("pointer"), A_FLOAT, A_FLOAT, 0);
         
     mousepad_widgetbehavior.w_getrectfn    = mousepad_getrect;
     mousepad_widgetbehavior.w_displacefn   = mousepad_displace;
@@ -921,6 +2886,22 @@ void mousepad_setup(void)
     symEmpty        = gensym("empty");
     symPos          = gensym("pos");
     symZoom         = gensym("zoom");
+    symPointer      = gensym("pointer");
+    symX            = gensym("#X");
+    symObj          = gensym("obj");
+    
+    glidelist   = 0;
+    palettelist = 0;
+    glideclock  = clock_new(0, (t_method)mousepad_glide_tick);
+    zoomlist    = 0;
+    zoomclock   = clock_new(0, (t_method)mousepad_zoom_flush);
+    repllist    = 0;
+    replclock   = clock_new(0, (t_method)mousepad_repl_flush);
+    replrefreshclock = clock_new(0, (t_method)mousepad_repl_refresh);
+    
+    draw_setup();
+    mousepad_mirror_setup();
+    mousepad_state_setup();
 }
 
 